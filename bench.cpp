@@ -0,0 +1,364 @@
+#include "cmdline.h"
+#include "utils.h"
+#include "subnx.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <functional>
+#include <stdexcept>
+#include <algorithm>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// synthetic taxdmp, accession2taxid and nt at a configurable scale
+struct Scale {
+    std::uint32_t taxa;
+    std::uint64_t accessions;  // rows of accession2taxid
+    std::uint64_t sequences;  // records of nt, a subset of the accessions
+    std::uint64_t bases;
+    std::vector<std::uint64_t> line_widths;  // one is picked per record
+    std::uint64_t seed;
+};
+
+// xorshift64*, fast enough to generate billions of bases
+class Random {
+public:
+    explicit Random(std::uint64_t seed) : state_(seed ? seed : 0x9e3779b97f4a7c15ULL) {}
+    std::uint64_t next() {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 0x2545f4914f6cdd1dULL;
+    }
+    std::uint64_t below(std::uint64_t n) {
+        return next() % n;
+    }
+private:
+    std::uint64_t state_;
+};
+
+// buffered writer on a FILE*, throws when the disk is full
+class Writer {
+public:
+    explicit Writer(const std::string& file) : file_(file), out_(std::fopen(file.c_str(), "wb")) {
+        if (out_ == nullptr) {
+            throw std::runtime_error(file + ": Failed to open file");
+        }
+        std::setvbuf(out_, nullptr, _IOFBF, 1 << 20);
+    }
+    ~Writer() {
+        if (out_ != nullptr) {
+            std::fclose(out_);
+        }
+    }
+    void write(const char* data, std::size_t n) {
+        if (std::fwrite(data, 1, n, out_) != n) {
+            throw std::runtime_error(file_ + ": Failed to write file");
+        }
+    }
+    void write(const std::string& data) {
+        write(data.data(), data.size());
+    }
+    void close() {
+        FILE* out = out_;
+        out_ = nullptr;
+        if (std::fclose(out) != 0) {
+            throw std::runtime_error(file_ + ": Failed to write file");
+        }
+    }
+private:
+    std::string file_;
+    FILE* out_;
+};
+
+// common NCBI accession layouts: letters, optional underscore, digits
+struct AccessionLayout {
+    std::size_t letters;
+    bool underscore;
+    std::size_t digits;
+};
+
+const AccessionLayout ACCESSION_LAYOUTS[] = {{2, false, 6}, {1, false, 5}, {4, false, 8}, {2, true, 6}, {6, false, 9}};
+
+// the i-th accession, unique for every i below the capacity of the layouts
+std::string make_accession(std::uint64_t i) {
+    const std::size_t layouts = sizeof(ACCESSION_LAYOUTS) / sizeof(ACCESSION_LAYOUTS[0]);
+    const AccessionLayout& layout = ACCESSION_LAYOUTS[i % layouts];
+    std::uint64_t n = i / layouts;
+    std::string digits(layout.digits, '0');
+    for (std::size_t j=layout.digits; j>0; --j, n/=10) {
+        digits[j-1] = static_cast<char>('0' + n % 10);
+    }
+    std::string letters(layout.letters, 'A');
+    for (std::size_t j=layout.letters; j>0; --j, n/=26) {
+        letters[j-1] = static_cast<char>('A' + n % 26);
+    }
+    return letters + (layout.underscore ? "_" : "") + digits;
+}
+
+const char* const RANKS[] = {"no rank", "superkingdom", "kingdom", "phylum", "class", "order", "family", "genus", "species"};
+
+void generate(const std::string& dir, const Scale& scale) {
+    Random random(scale.seed);
+    mkdir(dir.c_str(), 0755);
+    mkdir(os::path::join({dir, "taxdmp"}).c_str(), 0755);
+
+    // random tree, the parent of each taxon is one of the taxa before it
+    std::vector<std::uint32_t> taxids(scale.taxa);
+    std::vector<std::uint32_t> depths(scale.taxa, 0);
+    Writer names(os::path::join({dir, "taxdmp", "names.dmp"}));
+    Writer nodes(os::path::join({dir, "taxdmp", "nodes.dmp"}));
+    for (std::uint32_t i=0; i<scale.taxa; ++i) {
+        taxids[i] = (i == 0) ? 1 : 2 + i * 4 + static_cast<std::uint32_t>(random.below(4));
+        std::uint32_t parent = (i == 0) ? 0 : static_cast<std::uint32_t>(random.below(i));
+        depths[i] = (i == 0) ? 0 : depths[parent] + 1;
+        std::string taxid = std::to_string(taxids[i]);
+        std::string rank = RANKS[std::min<std::size_t>(depths[i], sizeof(RANKS) / sizeof(RANKS[0]) - 1)];
+        names.write(taxid + "\t|\tTaxon " + taxid + "\t|\t\t|\tscientific name\t|\n");
+        if (i % 3 == 0) {
+            names.write(taxid + "\t|\tTaxon " + taxid + " syn\t|\t\t|\tsynonym\t|\n");
+        }
+        nodes.write(taxid + "\t|\t" + std::to_string(taxids[parent]) + "\t|\t" + rank
+                    + "\t|\t\t|\t0\t|\t1\t|\t1\t|\t1\t|\t0\t|\t1\t|\t0\t|\t0\t|\t\t|\n");
+    }
+    names.close();
+    nodes.close();
+
+    // pool of random bases, lines are slices of it
+    std::string pool(1 << 20, 'A');
+    for (char& c : pool) {
+        c = "ACGT"[random.below(4)];
+    }
+
+    Writer accession2taxid(os::path::join({dir, "nucl_gb.accession2taxid"}));
+    Writer nt(os::path::join({dir, "nt"}));
+    accession2taxid.write("accession\taccession.version\ttaxid\tgi\n");
+    std::uint64_t mean = std::max<std::uint64_t>(1, scale.bases / std::max<std::uint64_t>(1, scale.sequences));
+    std::uint64_t written = 0;
+    for (std::uint64_t i=0; i<scale.accessions; ++i) {
+        std::string accession = make_accession(i);
+        std::string taxid = std::to_string(taxids[random.below(scale.taxa)]);
+        accession2taxid.write(accession + "\t" + accession + ".1\t" + taxid + "\t" + std::to_string(i + 1) + "\n");
+
+        // spread the sequences evenly over the accessions
+        if ((i * scale.sequences) / scale.accessions == ((i + 1) * scale.sequences) / scale.accessions) continue;
+        std::uint64_t length = mean / 2 + random.below(mean + 1);
+        std::uint64_t width = scale.line_widths[random.below(scale.line_widths.size())];
+        nt.write(">" + accession + ".1 Taxon " + taxid + " synthetic sequence\n");
+        for (std::uint64_t done=0; done<length; done+=width) {
+            std::uint64_t n = std::min(width, length - done);
+            nt.write(pool.data() + random.below(pool.size() - n), n);
+            nt.write("\n", 1);
+        }
+        written += length;
+    }
+    accession2taxid.close();
+    nt.close();
+    std::cerr << "Generated " << scale.taxa << " taxa, " << scale.accessions << " accessions, "
+              << scale.sequences << " sequences and " << written << " bases in " << dir << std::endl;
+}
+
+// drop the cached pages of a file so that the next read comes from disk
+void drop_cache(const std::string& file) {
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+}
+
+std::uint64_t total_size(const std::vector<std::string>& files) {
+    std::uint64_t size = 0;
+    for (const std::string& file : files) {
+        if (os::path::exists(file)) {
+            size += os::path::size(file);
+        }
+    }
+    return size;
+}
+
+// run a stage with cold and then warm page cache, one tab-separated row each;
+// the stage returns the number of records it produced, or -1 if it does not count them.
+// a sparse stage reads only parts of its inputs, about as much as it writes
+void measure(
+    const std::string& stage,
+    const std::vector<std::string>& inputs,
+    const std::vector<std::string>& outputs,
+    const std::function<std::int64_t()>& run,
+    bool sparse=false
+) {
+    for (const char* cache : {"cold", "warm"}) {
+        if (std::string(cache) == "cold") {
+            for (const std::string& input : inputs) {
+                drop_cache(input);
+            }
+        }
+        os::reset_peak_rss();
+        auto start = std::chrono::steady_clock::now();
+        std::int64_t records = run();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::uint64_t bytes_written = total_size(outputs);
+        std::uint64_t bytes_read = sparse ? bytes_written : total_size(inputs);
+        char throughput[32];
+        std::snprintf(throughput, sizeof(throughput), "%.1f", (seconds > 0) ? std::max(bytes_read, bytes_written) / seconds / (1 << 20) : 0.0);
+        char elapsed[32];
+        std::snprintf(elapsed, sizeof(elapsed), "%.3f", seconds);
+        std::cout << stage << "\t" << cache << "\t" << elapsed << "\t" << bytes_read << "\t" << bytes_written << "\t"
+                  << throughput << "\t" << ((records < 0) ? "NA" : std::to_string(records)) << "\t"
+                  << os::peak_rss() / 1024 << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    cmdline::parser parser;
+    parser.add<std::string>("dir", 'd', "directory of the synthetic data, generated if missing", true);
+    parser.add("generate", 'g', "(re)generate the data and exit");
+    parser.add<std::uint32_t>("taxa", 0, "number of taxa", false, 100000);
+    parser.add<std::uint64_t>("accessions", 0, "number of accession2taxid rows", false, 2000000);
+    parser.add<std::uint64_t>("sequences", 0, "number of nt records, at most --accessions", false, 500000);
+    parser.add<std::uint64_t>("bases", 0, "total number of bases in nt", false, 500000000);
+    parser.add<std::string>("line-widths", 0, "comma-separated line widths of nt, one is picked per record", false, "60,70,80");
+    parser.add<std::uint64_t>("seed", 0, "random seed", false, 1);
+    parser.add<unsigned int>("threads", 'p', "number of threads", false,
+                             std::max(1u, std::thread::hardware_concurrency()));
+    parser.parse_check(argc, argv);
+
+    const std::string dir = parser.get<std::string>("dir");
+    const unsigned int threads = std::max(1u, parser.get<unsigned int>("threads"));
+    Scale scale;
+    scale.taxa = std::max<std::uint32_t>(1, parser.get<std::uint32_t>("taxa"));
+    scale.accessions = std::max<std::uint64_t>(1, parser.get<std::uint64_t>("accessions"));
+    scale.sequences = std::min(scale.accessions, parser.get<std::uint64_t>("sequences"));
+    scale.bases = parser.get<std::uint64_t>("bases");
+    scale.seed = parser.get<std::uint64_t>("seed");
+    std::vector<std::string> widths;
+    str::split(parser.get<std::string>("line-widths"), ',', widths);
+    for (const std::string& width : widths) {
+        std::uint64_t value = 0;
+        if (str::to_uint(str::View(width.data(), width.size()), value) && (value > 0)) {
+            scale.line_widths.push_back(value);
+        }
+    }
+    if (scale.line_widths.empty()) {
+        std::cerr << "--line-widths: Invalid line widths" << std::endl;
+        return 1;
+    }
+
+    const std::string names_file = os::path::join({dir, "taxdmp", "names.dmp"});
+    const std::string nodes_file = os::path::join({dir, "taxdmp", "nodes.dmp"});
+    const std::string accession2taxid_file = os::path::join({dir, "nucl_gb.accession2taxid"});
+    const std::string nx_file = os::path::join({dir, "nt"});
+
+    try {
+        if (parser.exist("generate") || (! os::path::exists(names_file)) || (! os::path::exists(nodes_file))
+            || (! os::path::exists(accession2taxid_file)) || (! os::path::exists(nx_file))) {
+            generate(dir, scale);
+            if (parser.exist("generate")) {
+                return 0;
+            }
+        }
+
+        std::unordered_map<std::uint32_t, std::string> names;
+        Taxonomy taxonomy;
+        Node node;
+        AccessionTable accession_table;
+        std::unordered_map<Accession, std::uint32_t> accession2taxid;
+        std::unordered_set<Accession> accessions;
+        std::vector<Index> indexes;
+        const std::string table_file = accession2taxid_file + ".idx";
+        const std::string text_index_file = nx_file + ".fai";
+        const std::string index_file = nx_file + ".idx";
+        const std::string db_file = nx_file + ".db";
+        const std::string taxa_file = os::path::join({dir, "taxa.txt"});
+        const std::string seqs_file = os::path::join({dir, "seqs.fa"});
+
+        std::cout << "stage\tcache\tseconds\tbytes_read\tbytes_written\tmb_per_s\trecords\tpeak_rss_kb" << std::endl;
+        measure("NameIO::parse", {names_file}, {}, [&]() {
+            names.clear();
+            NameIO::parse(names_file, names);
+            return static_cast<std::int64_t>(names.size());
+        });
+        measure("NodeIO::parse", {nodes_file}, {}, [&]() {
+            Taxonomy parsed;
+            NodeIO::parse(nodes_file, names, parsed);
+            taxonomy = std::move(parsed);
+            return static_cast<std::int64_t>(taxonomy.size());
+        });
+
+        // extract the subtree closest to 5% of the taxa
+        std::uint32_t best = UINT32_MAX;
+        for (std::uint32_t i=0; i<taxonomy.size(); ++i) {
+            Node candidate = taxonomy.at(i);
+            std::uint32_t size = candidate.end() - candidate.index();
+            std::uint32_t distance = (size > taxonomy.size() / 20) ? size - taxonomy.size() / 20 : taxonomy.size() / 20 - size;
+            if (distance < best) {
+                best = distance;
+                node = candidate;
+            }
+        }
+        std::cerr << "Extracting node " << node.taxid() << " with " << (node.end() - node.index()) << " descendant nodes" << std::endl;
+
+        measure("Accession2TaxIdIO::parse", {accession2taxid_file}, {}, [&]() {
+            accession2taxid.clear();
+            Accession2TaxIdIO::parse(accession2taxid_file, taxonomy, {node}, accession_table, accession2taxid, threads);
+            return static_cast<std::int64_t>(accession2taxid.size());
+        });
+        measure("Accession2TaxIdTableIO::create", {accession2taxid_file}, {table_file}, [&]() {
+            Accession2TaxIdTableIO::create(accession2taxid_file, table_file, threads);
+            return std::int64_t(-1);
+        });
+        measure("Accession2TaxIdTableIO::parse", {table_file}, {}, [&]() {
+            accession2taxid.clear();
+            Accession2TaxIdTableIO::parse(table_file, accession2taxid_file, taxonomy, {node}, accession_table, accession2taxid);
+            return static_cast<std::int64_t>(accession2taxid.size());
+        });
+        for (const auto& pair : accession2taxid) {
+            accessions.insert(pair.first);
+        }
+
+        measure("IndexIO::create", {nx_file}, {text_index_file}, [&]() {
+            IndexIO::create(nx_file, text_index_file, threads);
+            return std::int64_t(-1);
+        });
+        measure("IndexIO::parse", {text_index_file}, {}, [&]() {
+            indexes.clear();
+            IndexIO::parse(text_index_file, accessions, indexes);
+            return static_cast<std::int64_t>(indexes.size());
+        });
+        measure("BinaryIndexIO::create", {nx_file}, {index_file}, [&]() {
+            BinaryIndexIO::create(nx_file, index_file, threads);
+            return std::int64_t(-1);
+        });
+        measure("BinaryIndexIO::parse", {index_file}, {}, [&]() {
+            indexes.clear();
+            BinaryIndexIO::parse(index_file, accessions, indexes);
+            return static_cast<std::int64_t>(indexes.size());
+        });
+        measure("DatabaseIO::create", {accession2taxid_file, index_file}, {db_file}, [&]() {
+            DatabaseIO::create(db_file, names_file, nodes_file, accession2taxid_file, nx_file, index_file, taxonomy, threads);
+            return std::int64_t(-1);
+        });
+        measure("DatabaseIO::parse", {db_file}, {}, [&]() {
+            AccessionTable joined_table;
+            std::unordered_map<Accession, std::uint32_t> joined;
+            std::vector<Index> found;
+            DatabaseIO::parse(db_file, names_file, nodes_file, accession2taxid_file, nx_file, taxonomy, {node}, joined_table, joined, found);
+            return static_cast<std::int64_t>(found.size());
+        });
+
+        measure("ResultIO::write_taxa", {}, {taxa_file}, [&]() {
+            ResultIO::write_taxa(indexes, accession2taxid, taxonomy, false, taxa_file);
+            return static_cast<std::int64_t>(indexes.size());
+        });
+        measure("ResultIO::write_seqs", {nx_file}, {seqs_file}, [&]() {
+            ResultIO::write_seqs(nx_file, indexes, seqs_file, threads);
+            return static_cast<std::int64_t>(indexes.size());
+        }, true);
+    } catch (const std::exception& exc) {
+        std::cerr << exc.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
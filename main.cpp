@@ -5,6 +5,11 @@
 #include <iomanip>
 #include <fstream>
 #include <iostream>
+#include <thread>
+#include <algorithm>
+#include <numeric>
+#include <csignal>
+#include <unistd.h>
 
 void log(const std::string& msg) {
     std::time_t time = std::time(nullptr);
@@ -12,16 +17,38 @@ void log(const std::string& msg) {
     std::cout << std::put_time(localtime, "[%H:%M:%S]") << " " << msg << std::endl;
 }
 
+Server* serving = nullptr;  // stopped on SIGINT and SIGTERM
+
+void stop_serving(int) {
+    if (serving != nullptr) {
+        serving->stop();
+    }
+}
+
 int main(int argc, char** argv) {
     std::time_t start = std::time(nullptr);
     cmdline::parser parser;
-    parser.add<std::string>("id", 'i', "taxon ID (e.g., 5455 for Colletotrichum)", true);
-    parser.add<std::string>("taxdmp-dir", 't', "decompressed taxdmp.zip directory", true);
-    parser.add<std::string>("accession2taxid-file", 'a', "decompressed accession2taxid file", true);
-    parser.add<std::string>("nx-file", 'n', "decompressed nt/nr sequences file", true);
+    parser.add<std::string>("id", 'i', "taxon ID (e.g., 5455 for Colletotrichum)", false);
+    parser.add<std::string>("taxdmp-dir", 't', "decompressed taxdmp.zip directory", false);
+    parser.add<std::string>("accession2taxid-file", 'a', "accession2taxid file, plain or gzip-compressed", false);
+    parser.add<std::string>("nx-file", 'n', "nt/nr sequences file, plain or gzip-compressed", false);
     parser.add("full-lineage", 'f', "output full lineage instead of principal ranks only");
     parser.add<std::string>("output-seqs-file", 's', "output sequences file, omit if not provide", false);
-    parser.add<std::string>("output-taxa-file", 'T', "output taxa file", true);
+    parser.add<std::string>("output-taxa-file", 'T', "output taxa file", false);
+    parser.add<std::string>("batch-file", 'b', "tab-separated taxon ID, taxa file and optional sequences file per line, replaces -i, -T and -s", false);
+    parser.add("export-index", 'x', "also export the index as a tab-separated text file (<nx-file>.fai)");
+    parser.add("build-table", 'A', "group accession2taxid by taxid into <accession2taxid-file>.idx for fast later runs without a database, then exit; "
+                                   "needs about 50 bytes of memory per accession2taxid line");
+    parser.add("build-db", 'B', "join accession2taxid with the nt/nr index into <nx-file>.db for fast later runs, then exit; "
+                                "needs about 50 bytes of memory per accession2taxid line");
+    parser.add<std::string>("serve", 'S', "keep the taxonomy and database in memory and answer requests on this unix domain socket, "
+                                                   "building the database first as -B does if needed", false);
+    parser.add<std::string>("connect", 'c', "send the request to a server listening on this unix domain socket, only -i, -T, -s, -f, -b, -d, -H and -p are used", false);
+    parser.add("dedup", 'd', "write each distinct sequence once per sequences file, the taxa file names the accession written for each");
+    parser.add<std::string>("header-filter", 'H', "keep records whose header description contains this text, or matches /regex/; prefix ! to drop them instead", false);
+    parser.add<std::string>("metrics-file", 'm', "write time, bytes, records and peak memory of each stage to this JSON file", false);
+    parser.add<unsigned int>("threads", 'p', "number of threads", false,
+                             std::max(1u, std::thread::hardware_concurrency()));
     parser.parse_check(argc, argv);
 
     const std::string id = parser.get<std::string>("id");
@@ -31,13 +58,72 @@ int main(int argc, char** argv) {
     const bool full_lineage = parser.exist("full-lineage");
     const std::string output_seqs_file = parser.get<std::string>("output-seqs-file");
     const std::string output_taxa_file = parser.get<std::string>("output-taxa-file");
+    const bool export_index = parser.exist("export-index");
+    const unsigned int threads = std::max(1u, parser.get<unsigned int>("threads"));
+    const std::string batch_file = parser.get<std::string>("batch-file");
+    const bool build_table = parser.exist("build-table");
+    const bool build_db = parser.exist("build-db");
+    const std::string socket_file = parser.get<std::string>("serve");
+    const std::string server_file = parser.get<std::string>("connect");
+    const std::string metrics_file = parser.get<std::string>("metrics-file");
+    const std::string header_filter = parser.get<std::string>("header-filter");
+    const bool dedup = parser.exist("dedup");
+    std::string command = argv[0];
+    for (int i=1; i<argc; ++i) {
+        command += std::string(" ") + argv[i];
+    }
+
+    // input files are read by the server, not by its clients; the table needs only accession2taxid
+    const bool table_only = build_table && (! build_db);
+    if (server_file.empty() && (accession2taxid_file.empty() || ((! table_only) && (taxdmp_dir.empty() || nx_file.empty())))) {
+        std::cerr << "--taxdmp-dir, --accession2taxid-file and --nx-file are required" << std::endl
+                  << parser.usage();
+        return 1;
+    }
+
+    // either a single taxon or a batch file, unless only the table or database is built or requests are served
+    if ((! build_table) && (! build_db) && socket_file.empty() && batch_file.empty() && (id.empty() || output_taxa_file.empty())) {
+        std::cerr << "either --id and --output-taxa-file, or --batch-file is required" << std::endl
+                  << parser.usage();
+        return 1;
+    }
+    if ((! batch_file.empty()) && (! os::path::exists(batch_file))) {
+        std::cerr << batch_file << ": No such file or directory" << std::endl;
+        return 1;
+    }
+
+    // let the server extract the targets one by one
+    if (! server_file.empty()) {
+        try {
+            std::vector<Target> targets;
+            if (batch_file.empty()) {
+                targets.emplace_back(id, output_taxa_file, output_seqs_file);
+            } else {
+                TargetIO::parse(batch_file, targets);
+            }
+            for (const Target& target : targets) {
+                Request request(target.id, target.taxa_file, target.seqs_file, full_lineage);
+                request.dedup = dedup;
+                request.threads = threads;
+                request.header_filter = header_filter;
+                std::size_t count = Client::request(server_file, request);
+                log("Server has written " + std::to_string(count) + " accessions of node " + target.id + " to " + target.taxa_file);
+            }
+        } catch (const std::exception& exc) {
+            std::cerr << exc.what() << std::endl;
+            return 1;
+        }
+        std::time_t end = std::time(nullptr);
+        log("Finished. Total time elapsed: " + std::to_string(end - start) + "s");
+        return 0;
+    }
 
-    // check if all files or directories exist
-    if (! os::path::exists(taxdmp_dir)) {
+    // check if all files or directories exist, building the table reads accession2taxid only
+    if ((! table_only) && (! os::path::exists(taxdmp_dir))) {
         std::cerr << taxdmp_dir << ": No such file or directory" << std::endl;
         return 1;
     }
-    if (! os::path::exists(nx_file)) {
+    if ((! table_only) && (! os::path::exists(nx_file))) {
         std::cerr << nx_file << ": No such file or directory" << std::endl;
         return 1;
     }
@@ -48,81 +134,289 @@ int main(int argc, char** argv) {
 
     // check if the taxdmp directory is valid
     std::string names_file = os::path::join({taxdmp_dir, "names.dmp"});
-    if (! os::path::exists(names_file)) {
+    if ((! table_only) && (! os::path::exists(names_file))) {
         std::cerr << names_file << ": No such file or directory" << std::endl;
         return 1;
     }
     std::string nodes_file = os::path::join({taxdmp_dir, "nodes.dmp"});
-    if (! os::path::exists(nodes_file)) {
+    if ((! table_only) && (! os::path::exists(nodes_file))) {
         std::cerr << nodes_file << ": No such file or directory" << std::endl;
         return 1;
     }
 
-    std::unordered_map<std::string, std::string> names;  // taxid to name
-    std::unordered_map<std::string, Node*> nodes;  // taxid to node
-    Node* node = nullptr;  // the node
-    std::vector<const Node*> descendants;  // node descendants
-    std::unordered_set<std::string> taxids;  // node descendant taxids
-    std::unordered_map<std::string, std::string> accession2taxid;  // accession to taxid
-    std::unordered_set<std::string> accessions;  // accessions
+    std::unordered_map<std::uint32_t, std::string> names;  // taxid to name
+    Taxonomy taxonomy;  // taxonomy tree
+    std::vector<Target> targets;  // taxa to extract
+    std::vector<Node> nodes;  // the node of each target
+    AccessionTable accession_table;  // accessions that do not pack
+    std::unordered_map<Accession, std::uint32_t> accession2taxid;  // accession to taxid
+    std::unordered_set<Accession> accessions;  // accessions
     std::vector<Index> indexes;  // indexes
+    Metrics metrics;  // stages of this run
+    os::Progress::enable(isatty(STDERR_FILENO));  // long scans report progress on a terminal only
+    auto write_metrics = [&]() {
+        if (! metrics_file.empty()) {
+            MetricsIO::write(metrics_file, metrics, command, threads);
+            log("Metrics have been written to " + metrics_file);
+        }
+    };
 
     try {
-        // parse nodes
-        NameIO::parse(names_file, names);
-        if (names.empty()) {
-            std::cerr << names_file << ": Invalid names file" << std::endl;
-            return 1;
+        const HeaderFilter filter(header_filter);  // an invalid regular expression fails before any work
+        if (build_table || build_db || (! socket_file.empty())) {
+            // no targets
+        } else if (batch_file.empty()) {
+            targets.emplace_back(id, output_taxa_file, output_seqs_file);
+        } else {
+            TargetIO::parse(batch_file, targets);
+            log("Loaded " + std::to_string(targets.size()) + " targets from " + batch_file);
         }
-        NodeIO::parse(nodes_file, names, nodes);
-        if (nodes.empty()) {
-            std::cerr << nodes_file << ": Invalid nodes file" << std::endl;
-            return 1;
+
+        // group accession2taxid by taxid only on request, the whole file is sorted in memory
+        const std::string table_file = accession2taxid_file + ".idx";
+        if (build_table) {
+            metrics.start("table");
+            log("Indexing " + accession2taxid_file + " with " + std::to_string(threads) + " threads");
+            Accession2TaxIdTableIO::create(accession2taxid_file, table_file, threads);
+            metrics.stop({accession2taxid_file}, {table_file}, -1, -1);
+            log("Table has been written to " + table_file);
+            if (table_only) {
+                write_metrics();
+                std::time_t end = std::time(nullptr);
+                log("Finished. Total time elapsed: " + std::to_string(end - start) + "s");
+                return 0;
+            }
         }
-        log("Loaded " + std::to_string(nodes.size()) + " nodes from " + taxdmp_dir);
 
-        // get node
-        if (nodes.find(id) == nodes.end()) {
-            std::cerr << id << ": Taxon ID not found" << std::endl;
-            return 1;
+        // load nodes from the snapshot, or parse them and save a snapshot for later runs
+        const std::string snapshot_file = os::path::join({taxdmp_dir, "subnx.taxonomy"});
+        metrics.start("taxonomy");
+        if (TaxonomyIO::load(snapshot_file, names_file, nodes_file, taxonomy)) {
+            metrics.stop({snapshot_file}, {}, taxonomy.size(), taxonomy.size());
+            log("Loaded " + std::to_string(taxonomy.size()) + " nodes from " + snapshot_file);
+        } else {
+            NameIO::parse(names_file, names);
+            if (names.empty()) {
+                std::cerr << names_file << ": Invalid names file" << std::endl;
+                return 1;
+            }
+            NodeIO::parse(nodes_file, names, taxonomy);
+            if (taxonomy.empty()) {
+                std::cerr << nodes_file << ": Invalid nodes file" << std::endl;
+                return 1;
+            }
+            names.clear();
+            metrics.stop({names_file, nodes_file}, {}, taxonomy.size(), taxonomy.size());
+            log("Loaded " + std::to_string(taxonomy.size()) + " nodes from " + taxdmp_dir);
+            try {
+                TaxonomyIO::save(snapshot_file, names_file, nodes_file, taxonomy);
+            } catch (const std::exception& exc) {
+                log(std::string("Warning: ") + exc.what() + ", taxonomy will be parsed again next time");
+            }
         }
-        node = nodes.at(id);
 
-        // get descendant nodes
-        node->expand(descendants);
-        for (const Node* descendant : descendants) {
-            taxids.insert(descendant->id);
+        // index sequences file if index doesn't exist, reusing a text index if present;
+        // an existing index is extended when the sequences file was appended to, and rebuilt when it was replaced
+        const std::string index_file = nx_file + ".idx";
+        const std::string text_index_file = nx_file + ".fai";
+        auto prepare_index = [&]() {
+            if ((! os::path::exists(index_file)) && os::path::exists(text_index_file)) {
+                metrics.start("index");
+                log("Converting " + text_index_file + " to binary index (required only for the first run)");
+                BinaryIndexIO::convert(text_index_file, index_file, nx_file);
+                metrics.stop({text_index_file}, {index_file}, -1, -1);
+            }
+            BinaryIndexIO::Status status = BinaryIndexIO::check(nx_file, index_file);
+            if (status == BinaryIndexIO::APPENDED) {
+                metrics.start("index-append");
+                log("Indexing records appended to " + nx_file + " since " + index_file + " was built");
+                BinaryIndexIO::append(nx_file, index_file, threads);
+                metrics.stop({nx_file}, {index_file}, -1, -1);
+            } else if (status == BinaryIndexIO::STALE) {
+                metrics.start("index");
+                if (os::path::exists(index_file)) {
+                    log("Re-indexing with " + std::to_string(threads) + " threads, " + index_file + " is out of date");
+                } else {
+                    log("Indexing with " + std::to_string(threads) + " threads (required only for the first run)");
+                }
+                BinaryIndexIO::create(nx_file, index_file, threads);
+                metrics.stop({nx_file}, {index_file}, -1, -1);
+            }
+            if (export_index) {
+                metrics.start("export-index");
+                BinaryIndexIO::dump(index_file, text_index_file);
+                metrics.stop({index_file}, {text_index_file}, -1, -1);
+                log("Index has been exported to " + text_index_file);
+            }
+        };
+
+        // join accession2taxid with the index once, later runs read subtrees from the database
+        const std::string db_file = nx_file + ".db";
+        if (build_db) {
+            prepare_index();
+            metrics.start("database");
+            DatabaseIO::create(db_file, names_file, nodes_file, accession2taxid_file, nx_file, index_file, taxonomy, threads);
+            metrics.stop({accession2taxid_file, index_file}, {db_file}, -1, -1);
+            log("Database has been written to " + db_file);
+            write_metrics();
+            std::time_t end = std::time(nullptr);
+            log("Finished. Total time elapsed: " + std::to_string(end - start) + "s");
+            return 0;
+        }
+
+        // build the database if needed and keep it mapped while serving
+        if (! socket_file.empty()) {
+            Database database;
+            if (! database.load(db_file, names_file, nodes_file, accession2taxid_file, nx_file, taxonomy)) {
+                prepare_index();
+                log("Building " + db_file + " with " + std::to_string(threads) + " threads (required only for the first run)");
+                DatabaseIO::create(db_file, names_file, nodes_file, accession2taxid_file, nx_file, index_file, taxonomy, threads);
+                if (! database.load(db_file, names_file, nodes_file, accession2taxid_file, nx_file, taxonomy)) {
+                    std::cerr << db_file << ": Invalid database" << std::endl;
+                    return 1;
+                }
+            }
+            os::Progress::enable(false);  // concurrent requests would overwrite each other's line
+            Server server(taxonomy, database, nx_file, threads);
+            server.listen(socket_file);
+            serving = &server;
+            std::signal(SIGINT, stop_serving);
+            std::signal(SIGTERM, stop_serving);
+            log("Serving requests on " + socket_file + " with " + std::to_string(threads) + " threads");
+            server.serve();
+            serving = nullptr;
+            log("Server stopped");
+            return 0;
         }
-        log("Traced " + std::to_string(descendants.size()) + " descendant nodes for node " + id);
 
-        // parse accessions
-        Accession2TaxIdIO::parse(accession2taxid_file, taxids, accession2taxid);
-        for (const auto& pair : accession2taxid) {
-            accessions.insert(pair.first);
+        // get nodes, descendant nodes are the pre-order range [node, end)
+        for (const Target& target : targets) {
+            Node node;
+            std::uint64_t taxid = 0;
+            if (str::to_uint(str::View(target.id.data(), target.id.size()), taxid) && (taxid <= UINT32_MAX)) {
+                node = taxonomy.find(taxid);
+            }
+            if (! node.valid()) {
+                std::cerr << target.id << ": Taxon ID not found" << std::endl;
+                return 1;
+            }
+            nodes.push_back(node);
+            log("Traced " + std::to_string(node.end() - node.index()) + " descendant nodes for node " + target.id);
         }
-        log("Found " + std::to_string(accession2taxid.size()) + " related accessions in " + accession2taxid_file);
 
-        // index sequences file if index doesn't exist
-        const std::string index_file = nx_file + ".fai";
-        if (! os::path::exists(index_file)) {
-            log("Indexing, estimated time required: 1 hour (required only for the first run)");
-            IndexIO::create(nx_file, index_file);
+        metrics.start("database-lookup");
+        if (DatabaseIO::parse(db_file, names_file, nodes_file, accession2taxid_file, nx_file, taxonomy, nodes, accession_table, accession2taxid, indexes)) {
+            metrics.stop({db_file}, {}, indexes.size(), indexes.size());
+            log("Found " + std::to_string(indexes.size()) + " accessions in " + db_file);
+            if (export_index) {
+                prepare_index();
+            }
+        } else {
+            // look up accessions of all targets in the table grouped by taxid if one was built with -A
+            // and is up to date, otherwise scan the whole file in a single pass
+            metrics.cancel();  // no usable database
+            metrics.start("accession2taxid");
+            if (Accession2TaxIdTableIO::parse(table_file, accession2taxid_file, taxonomy, nodes, accession_table, accession2taxid)) {
+                metrics.stop({table_file}, {}, accession2taxid.size(), accession2taxid.size());
+            } else {
+                std::uint64_t lines = Accession2TaxIdIO::parse(accession2taxid_file, taxonomy, nodes, accession_table, accession2taxid, threads);
+                metrics.stop({accession2taxid_file}, {}, lines, accession2taxid.size());
+            }
+            for (const auto& pair : accession2taxid) {
+                accessions.insert(pair.first);
+            }
+            log("Found " + std::to_string(accession2taxid.size()) + " related accessions in " + accession2taxid_file);
+
+            // parse indexes
+            prepare_index();
+            metrics.start("index-lookup");
+            BinaryIndexIO::parse(index_file, accessions, indexes);
+            metrics.stop({index_file}, {}, accessions.size(), indexes.size());
+            log("Found " + std::to_string(indexes.size()) + "" + " accessions existing in " + nx_file);
         }
 
-        // parse indexes
-        IndexIO::parse(index_file, accessions, indexes);
-        log("Found " + std::to_string(indexes.size()) + "" + " accessions existing in " + nx_file);
+        // drop records by their header descriptions, saved apart on the first filtered run,
+        // so that no sequence bytes of the dropped ones are read
+        if (! filter.empty()) {
+            const std::string description_file = nx_file + ".desc";
+            std::size_t found = indexes.size();
+            metrics.start("header-filter");
+            if (DescriptionIO::filter(description_file, nx_file, filter, indexes)) {
+                metrics.stop({description_file}, {}, found, indexes.size());
+            } else {
+                log("Saving header descriptions to " + description_file + " (required only for the first filtered run)");
+                DescriptionIO::create(nx_file, description_file, threads);
+                if (! DescriptionIO::filter(description_file, nx_file, filter, indexes)) {
+                    std::cerr << description_file << ": Invalid description file" << std::endl;
+                    return 1;
+                }
+                metrics.stop({nx_file}, {description_file}, found, indexes.size());
+            }
+            log("Kept " + std::to_string(indexes.size()) + " of " + std::to_string(found) + " accessions whose header matches " + header_filter);
+        }
 
-        // write results
-        ResultIO::write_taxa(indexes, accession2taxid, nodes, full_lineage, output_taxa_file);
-        log("Taxonomic information has been written to " + output_taxa_file);
-        if (! output_seqs_file.empty()) {
-            ResultIO::write_seqs(nx_file, indexes, output_seqs_file);
-            log("Sequences have been written to " + output_seqs_file);
+        // write results, sequences of all targets are extracted in a single pass; when deduplicating
+        // they are written first, so that the taxa files can name the record kept for each accession
+        std::vector<std::vector<std::size_t>> selections(targets.size());
+        std::vector<std::vector<std::size_t>> representatives(targets.size());  // empty unless deduplicated
+        std::vector<std::size_t> seqs_targets;  // targets with a sequences file
+        for (std::size_t i=0; i<targets.size(); ++i) {
+            ResultIO::select(indexes, accession2taxid, taxonomy, nodes[i], selections[i]);
+            if (! targets[i].seqs_file.empty()) {
+                seqs_targets.push_back(i);
+            }
+        }
+        auto write_seqs = [&]() {
+            std::vector<std::vector<std::size_t>> seqs_selections;
+            std::vector<std::string> seqs_files;
+            std::size_t selected = 0;
+            for (std::size_t i : seqs_targets) {
+                seqs_selections.push_back(selections[i]);
+                seqs_files.push_back(targets[i].seqs_file);
+                selected += selections[i].size();
+            }
+            metrics.start("sequences");
+            if (! dedup) {
+                ResultIO::write_seqs(nx_file, indexes, seqs_selections, seqs_files, threads);
+                metrics.stop({}, seqs_files, selected, selected);
+                for (const std::string& seqs_file : seqs_files) {
+                    log("Sequences have been written to " + seqs_file);
+                }
+                return;
+            }
+            std::vector<std::vector<std::size_t>> seqs_representatives;
+            ResultIO::write_seqs(nx_file, indexes, seqs_selections, seqs_files, seqs_representatives, threads);
+            std::vector<std::size_t> kept(seqs_targets.size(), 0);
+            for (std::size_t k=0; k<seqs_targets.size(); ++k) {
+                for (std::size_t j=0; j<seqs_selections[k].size(); ++j) {
+                    kept[k] += (seqs_representatives[k][j] == seqs_selections[k][j]) ? 1 : 0;
+                }
+                representatives[seqs_targets[k]] = std::move(seqs_representatives[k]);
+            }
+            metrics.stop({}, seqs_files, selected, std::accumulate(kept.begin(), kept.end(), std::size_t(0)));
+            for (std::size_t k=0; k<seqs_targets.size(); ++k) {
+                log("Sequences of " + std::to_string(kept[k]) + " distinct records among " + std::to_string(seqs_selections[k].size())
+                    + " accessions have been written to " + seqs_files[k]);
+            }
+        };
+        if (dedup && (! seqs_targets.empty())) {
+            write_seqs();
+        }
+        std::vector<std::string> taxa_files;
+        std::size_t selected = 0;
+        metrics.start("taxa");
+        for (std::size_t i=0; i<targets.size(); ++i) {
+            ResultIO::write_taxa(indexes, selections[i], representatives[i], accession2taxid, taxonomy, full_lineage, targets[i].taxa_file);
+            log("Taxonomic information of " + std::to_string(selections[i].size()) + " accessions has been written to " + targets[i].taxa_file);
+            taxa_files.push_back(targets[i].taxa_file);
+            selected += selections[i].size();
+        }
+        metrics.stop({}, taxa_files, indexes.size() * targets.size(), selected);
+        if ((! dedup) && (! seqs_targets.empty())) {
+            write_seqs();
         }
+        write_metrics();
 
-        // destroy all nodes
-        NodeIO::destroy(nodes);
         std::time_t end = std::time(nullptr);
         log("Finished. Total time elapsed: " + std::to_string(end - start) + "s");
     } catch (const std::exception& exc) {
@@ -1,287 +1,2999 @@
 #include "utils.h"
 #include "subnx.h"
 #include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <exception>
+#include <functional>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <unistd.h>
 
-void NameIO::parse(const std::string& file, std::unordered_map<std::string, std::string>& names) {
+namespace {
+
+// run task(0), ..., task(n-1) on n threads and rethrow the first failure
+void run_parallel(std::size_t n, const std::function<void(std::size_t)>& task) {
+    if (n == 1) {
+        task(0);
+        return;
+    }
+    std::vector<std::thread> workers;
+    std::vector<std::exception_ptr> errors(n);
+    for (std::size_t i=0; i<n; ++i) {
+        workers.emplace_back([&task, &errors, i]() {
+            try {
+                task(i);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+// split [begin, end) into up to n ranges that start at the beginning of a line
+void split_lines(const char* data, std::size_t begin, std::size_t end, unsigned int n, std::vector<std::size_t>& bounds) {
+    n = std::max<std::size_t>(1, std::min<std::size_t>(n, end - begin));
+    bounds.assign(1, begin);
+    for (std::size_t i=1; i<n; ++i) {
+        std::size_t pos = std::max(begin + (end - begin) * i / n, bounds.back());
+        const void* newline = (pos < end) ? memchr(data + pos, '\n', end - pos) : nullptr;
+        pos = newline ? static_cast<const char*>(newline) - data + 1 : end;
+        if (pos > bounds.back() && pos < end) {
+            bounds.push_back(pos);
+        }
+    }
+    bounds.push_back(end);
+}
+
+// call visit(first, last) for every line in [begin, end), without the line ending
+template <typename F>
+void for_each_line(const char* data, std::size_t begin, std::size_t end, F visit) {
+    const char* p = data + begin;
+    const char* last = data + end;
+    while (p < last) {
+        const char* newline = static_cast<const char*>(memchr(p, '\n', last - p));
+        const char* eol = newline ? newline : last;
+        visit(p, eol);
+        p = eol + 1;
+    }
+}
+
+// call visit(data, size, offset) for consecutive newline-aligned chunks of a gzip file,
+// offset is the position of data[0] in the decompressed stream
+template <typename F>
+void for_each_gzip_chunk(const std::string& file, F visit) {
+    os::GzipReader in(file);
+    os::Progress progress(file, os::path::size(file));
+    std::string block;
+    std::string chunk;
+    std::uint64_t offset = 0;
+    while (in.next(block)) {
+        chunk.append(block);
+        std::size_t last = chunk.rfind('\n');
+        if (last == std::string::npos) continue;
+        visit(chunk.data(), last + 1, offset);
+        offset += last + 1;
+        chunk.erase(0, last + 1);  // carry the partial line over
+        progress.set(in.tell());
+    }
+    if (! chunk.empty()) {
+        visit(chunk.data(), chunk.size(), offset);
+    }
+}
+
+static const std::size_t WRITE_BUFFER_SIZE = 1 << 20;
+static const std::size_t SCAN_SLICE_SIZE = 64 << 20;  // bytes of a mapped file scanned between progress updates
+static const std::size_t COPY_BUFFER_SIZE = 4 << 20;
+static const std::uint64_t COALESCE_GAP = 64 << 10;  // bytes worth reading over to join two reads
+static const std::uint64_t HASH_BATCH_SIZE = 64 << 20;  // bytes of records hashed together, then written while cached
+
+// contiguous bytes of the sequences file copied to one output
+struct Run {
+    std::uint64_t pos;
+    std::uint64_t length;
+    std::uint32_t output;
+};
+
+// merge the selected records of every output into runs of adjacent records, ordered by position
+void collect_runs(
+    const std::vector<Index>& indexes,
+    const std::vector<std::vector<std::size_t>>& selections,
+    std::vector<Run>& runs
+) {
+    std::vector<std::size_t> selection;
+    for (std::size_t k=0; k<selections.size(); ++k) {
+        selection = selections[k];
+        std::sort(selection.begin(), selection.end(), [&indexes](std::size_t a, std::size_t b) {
+            return indexes[a].pos < indexes[b].pos;
+        });
+        const Index* last = nullptr;
+        for (std::size_t i : selection) {
+            const Index& index = indexes[i];
+            if ((last != nullptr) && (last->pos == index.pos)) {
+                continue;  // another accession of the same record
+            }
+            last = &index;
+            if ((! runs.empty()) && (runs.back().output == k) && (runs.back().pos + runs.back().length == index.pos)) {
+                runs.back().length += index.length;
+            } else {
+                runs.push_back(Run{index.pos, index.length, static_cast<std::uint32_t>(k)});
+            }
+        }
+    }
+    std::stable_sort(runs.begin(), runs.end(), [](const Run& a, const Run& b) {
+        return a.pos < b.pos;
+    });
+}
+
+// copy runs on several threads: every output is preallocated to its final size and each piece
+// goes to the offset given by a prefix sum over its output's runs, so the result does not
+// depend on the schedule; returns false if an output cannot be preallocated (e.g. a pipe)
+bool copy_runs_parallel(const os::File& in, const std::vector<Run>& runs, std::vector<os::File>& outs, unsigned int threads) {
+    struct Piece {
+        std::uint64_t pos;
+        std::uint64_t length;
+        std::uint64_t out_offset;
+        std::uint32_t output;
+    };
+    std::vector<Piece> pieces;
+    std::vector<std::uint64_t> sizes(outs.size(), 0);
+    for (const Run& run : runs) {
+        for (std::uint64_t done=0; done<run.length; ) {
+            std::uint64_t n = std::min<std::uint64_t>(COPY_BUFFER_SIZE, run.length - done);
+            pieces.push_back(Piece{run.pos + done, n, sizes[run.output], run.output});
+            sizes[run.output] += n;
+            done += n;
+        }
+    }
+    for (std::size_t k=0; k<outs.size(); ++k) {
+        if (! outs[k].allocate(sizes[k])) {
+            return false;
+        }
+    }
+
+    // contiguous slices of pieces with similar byte counts, so each thread reads forward
+    std::uint64_t total = 0;
+    for (std::uint64_t size : sizes) {
+        total += size;
+    }
+    std::size_t n = std::max<std::size_t>(1, std::min<std::size_t>(threads, pieces.size()));
+    std::vector<std::size_t> bounds(1, 0);
+    std::uint64_t sum = 0;
+    for (std::size_t i=0; i<pieces.size(); ++i) {
+        sum += pieces[i].length;
+        if ((bounds.size() < n) && (sum >= total * bounds.size() / n)) {
+            bounds.push_back(i + 1);
+        }
+    }
+    bounds.push_back(pieces.size());
+    run_parallel(bounds.size() - 1, [&](std::size_t t) {
+        std::string buffer;
+        bool zero_copy = true;
+        for (std::size_t i=bounds[t]; i<bounds[t+1]; ++i) {
+            const Piece& piece = pieces[i];
+            if (zero_copy && outs[piece.output].copy_from(in, piece.pos, piece.length, piece.out_offset)) {
+                continue;
+            }
+            zero_copy = false;
+            buffer.resize(piece.length);
+            in.pread(&buffer[0], piece.length, piece.pos);
+            outs[piece.output].pwrite(buffer.data(), piece.length, piece.out_offset);
+        }
+    });
+    return true;
+}
+
+// copy runs of a plain file, in parallel if more threads are given; sequentially, in the kernel
+// where possible, otherwise joining nearby runs into large reads through one buffer
+void copy_runs(const std::string& infile, const std::vector<Run>& runs, std::vector<os::File>& outs, unsigned int threads) {
+    os::File in(infile, os::File::READ);
+    if ((threads > 1) && (runs.size() > 1) && copy_runs_parallel(in, runs, outs, threads)) {
+        return;
+    }
+    bool zero_copy = true;
+    std::string buffer;
+    std::size_t i = 0;
+    while (i < runs.size()) {
+        const Run& run = runs[i];
+        if (zero_copy && outs[run.output].copy_from(in, run.pos, run.length)) {
+            ++i;
+            continue;
+        }
+        zero_copy = false;
+        std::uint64_t first = run.pos;
+        std::uint64_t last = run.pos + run.length;
+        std::size_t j = i + 1;
+        while ((j < runs.size()) && (runs[j].pos <= last + COALESCE_GAP)
+               && (std::max(last, runs[j].pos + runs[j].length) - first <= COPY_BUFFER_SIZE)) {
+            last = std::max(last, runs[j].pos + runs[j].length);
+            ++j;
+        }
+        if (last - first > COPY_BUFFER_SIZE) {  // a single large run
+            buffer.resize(COPY_BUFFER_SIZE);
+            for (std::uint64_t done=0; done<run.length; ) {
+                std::size_t n = std::min<std::uint64_t>(COPY_BUFFER_SIZE, run.length - done);
+                in.pread(&buffer[0], n, run.pos + done);
+                outs[run.output].write(buffer.data(), n);
+                done += n;
+            }
+        } else {
+            buffer.resize(last - first);
+            in.pread(&buffer[0], last - first, first);
+            for (std::size_t k=i; k<j; ++k) {
+                outs[runs[k].output].write(buffer.data() + (runs[k].pos - first), runs[k].length);
+            }
+        }
+        i = j;
+    }
+}
+
+// copy runs of a plain, BGZF or gzip sequences file to their outputs
+void write_runs(const std::string& infile, const std::vector<Run>& runs, std::vector<os::File>& outs, unsigned int threads) {
+    if (os::path::is_bgzf(infile)) {
+        // BGZF blocks are inflated on demand, only those holding selected records are read
+        os::BgzfFile in(infile);
+        std::string buffer;
+        for (const Run& run : runs) {
+            for (std::uint64_t done=0; done<run.length; done+=buffer.size()) {
+                buffer.clear();
+                in.read(run.pos + done, std::min<std::uint64_t>(COPY_BUFFER_SIZE, run.length - done), buffer);
+                outs[run.output].write(buffer.data(), buffer.size());
+            }
+        }
+    } else if (os::path::is_gzip(infile)) {
+        // plain gzip cannot seek, so sweep the decompressed stream once and copy the runs as they pass by
+        os::GzipReader in(infile);
+        os::Progress progress(infile, os::path::size(infile));
+        std::string block;
+        std::uint64_t offset = 0;
+        std::size_t i = 0;  // first unfinished run
+        while ((i < runs.size()) && in.next(block)) {
+            progress.set(in.tell());
+            std::uint64_t end = offset + block.size();
+            for (std::size_t j=i; (j < runs.size()) && (runs[j].pos < end); ++j) {
+                std::uint64_t first = std::max<std::uint64_t>(runs[j].pos, offset);
+                std::uint64_t last = std::min<std::uint64_t>(runs[j].pos + runs[j].length, end);
+                if (first < last) {
+                    outs[runs[j].output].write(block.data() + (first - offset), last - first);
+                }
+            }
+            while ((i < runs.size()) && (runs[i].pos + runs[i].length <= end)) {
+                ++i;
+            }
+            offset = end;
+        }
+        if (i < runs.size()) {
+            throw std::runtime_error(infile + ": Failed to read record at " + std::to_string(runs[i].pos));
+        }
+    } else {
+        copy_runs(infile, runs, outs, threads);
+    }
+}
+
+// reads records at increasing positions of a BGZF or gzip sequences file in pieces of at most
+// COPY_BUFFER_SIZE bytes; plain gzip is swept once so a position must not lie before the previous one
+class RecordReader {
+public:
+    explicit RecordReader(const std::string& file) : file_(file), offset_(0) {
+        if (os::path::is_bgzf(file)) {
+            bgzf_.reset(new os::BgzfFile(file));
+        } else {
+            gzip_.reset(new os::GzipReader(file));
+            progress_.reset(new os::Progress(file, os::path::size(file)));
+        }
+    }
+    // pass the bytes [pos, pos + length) to visit(data, n), piece by piece
+    template <typename Visit>
+    void read(std::uint64_t pos, std::uint64_t length, Visit visit) {
+        for (std::uint64_t done=0; done<length; ) {
+            std::uint64_t next = pos + done;
+            std::size_t n = std::min<std::uint64_t>(COPY_BUFFER_SIZE, length - done);
+            if (bgzf_) {
+                buffer_.clear();
+                bgzf_->read(next, n, buffer_);
+                visit(buffer_.data(), n);
+            } else {
+                std::uint64_t end = offset_ + block_.size();
+                if ((next < offset_) || (next >= end)) {
+                    if ((next < offset_) || (! gzip_->next(block_))) {
+                        throw std::runtime_error(file_ + ": Failed to read record at " + std::to_string(pos));
+                    }
+                    offset_ = end;
+                    progress_->set(gzip_->tell());
+                    continue;
+                }
+                n = std::min<std::uint64_t>(n, end - next);
+                visit(block_.data() + (next - offset_), n);
+            }
+            done += n;
+        }
+    }
+private:
+    std::string file_;
+    std::unique_ptr<os::BgzfFile> bgzf_;
+    std::unique_ptr<os::GzipReader> gzip_;
+    std::unique_ptr<os::Progress> progress_;
+    std::string buffer_;  // the BGZF piece being visited
+    std::string block_;  // the gzip block being swept, starting at offset_
+    std::uint64_t offset_;
+};
+
+// splitmix64 finalizer
+std::uint64_t mix64(std::uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// content hash of the sequence of a record in two independent 64-bit lanes, fed piece by piece;
+// the header line and line breaks are left out so that the same sequence wrapped at other
+// widths hashes alike
+class Fingerprint {
+public:
+    struct Digest {
+        std::uint64_t h1;
+        std::uint64_t h2;
+
+        bool operator==(const Digest& other) const {
+            return (h1 == other.h1) && (h2 == other.h2);
+        }
+    };
+public:
+    Fingerprint() : h1_(0xcbf29ce484222325ULL), h2_(0x9e3779b97f4a7c15ULL), length_(0), header_(true) {}
+    void update(const char* data, std::size_t n) {
+        std::size_t i = 0;
+        if (header_) {
+            const void* newline = memchr(data, '\n', n);
+            if (newline == nullptr) {
+                return;
+            }
+            i = static_cast<const char*>(newline) - data + 1;
+            header_ = false;
+        }
+        std::uint64_t h1 = h1_;
+        std::uint64_t h2 = h2_;
+        std::uint64_t length = length_;
+        for (; i<n; ++i) {
+            unsigned char c = data[i];
+            if ((c == '\n') || (c == '\r')) continue;
+            h1 = (h1 ^ c) * 0x100000001b3ULL;  // FNV-1a
+            h2 = (h2 + c) * 0xff51afd7ed558ccdULL;
+            h2 ^= h2 >> 32;
+            ++length;
+        }
+        h1_ = h1;
+        h2_ = h2;
+        length_ = length;
+    }
+    Digest digest() const {
+        return Digest{mix64(h1_ ^ length_), mix64(h2_ + length_)};
+    }
+private:
+    std::uint64_t h1_;
+    std::uint64_t h2_;
+    std::uint64_t length_;  // sequence bytes so far
+    bool header_;  // still in the header line
+};
+
+struct DigestHash {
+    std::size_t operator()(const Fingerprint::Digest& digest) const {
+        return static_cast<std::size_t>(digest.h1);
+    }
+};
+
+// a record read from a compressed file, kept until it is known which outputs it is new to
+// so that it is inflated only once: the first COPY_BUFFER_SIZE bytes are held in memory and the rest
+// spilled to a temporary file, created on the first record that needs it
+class HeldRecord {
+public:
+    explicit HeldRecord(const std::string& spill_file) : spill_file_(spill_file), size_(0) {}
+    HeldRecord(const HeldRecord&) = delete;
+    HeldRecord& operator=(const HeldRecord&) = delete;
+    ~HeldRecord() {
+        if (spill_.fd() >= 0) {
+            std::remove(spill_file_.c_str());
+        }
+    }
+    void clear() {
+        buffer_.clear();
+        size_ = 0;
+    }
+    void append(const char* data, std::size_t n) {
+        std::uint64_t spilled = size_ - buffer_.size();
+        std::size_t m = std::min(n, COPY_BUFFER_SIZE - buffer_.size());
+        buffer_.append(data, m);
+        if (m < n) {
+            if (spill_.fd() < 0) {
+                spill_ = os::File(spill_file_, os::File::WRITE);
+                spilled_ = os::File(spill_file_, os::File::READ);
+            }
+            spill_.pwrite(data + m, n - m, spilled);
+        }
+        size_ += n;
+    }
+    void write(os::File& out) {
+        out.write(buffer_.data(), buffer_.size());
+        std::uint64_t spilled = size_ - buffer_.size();
+        if ((spilled == 0) || out.copy_from(spilled_, 0, spilled)) {
+            return;
+        }
+        std::string piece(std::min<std::uint64_t>(COPY_BUFFER_SIZE, spilled), '\0');
+        for (std::uint64_t done=0; done<spilled; ) {
+            std::size_t n = std::min<std::uint64_t>(piece.size(), spilled - done);
+            spilled_.pread(&piece[0], n, done);
+            out.write(piece.data(), n);
+            done += n;
+        }
+    }
+private:
+    std::string spill_file_;
+    os::File spill_;
+    os::File spilled_;  // spill_ opened for reading
+    std::string buffer_;
+    std::uint64_t size_;  // bytes of the record, held and spilled
+};
+
+// record start in a mapped fasta file, the header begins at data[pos+1]
+struct Header {
+    std::size_t pos;
+    std::size_t accession_length;
+    std::size_t version_length;
+};
+
+Header parse_header(const char* data, std::size_t size, std::size_t pos) {
+    const char* begin = data + pos + 1;
+    const char* end = data + size;
+    const char* p = begin;
+    while ((p != end) && (*p != ' ') && (*p != '\n') && (*p != '\x01')) {
+        ++p;
+    }
+    Header header;
+    header.pos = pos;
+    header.version_length = p - begin;
+    const void* dot = memchr(begin, '.', header.version_length);
+    header.accession_length = dot ? static_cast<const char*>(dot) - begin : header.version_length;
+    return header;
+}
+
+// the header line of the record at data[pos] without '>' and the line break
+str::View header_line(const char* data, std::size_t size, std::size_t pos) {
+    const char* begin = data + pos + 1;
+    const void* newline = memchr(begin, '\n', size - pos - 1);
+    return str::View(begin, newline ? static_cast<const char*>(newline) - begin : size - pos - 1);
+}
+
+// visit(version, accession_length, version_length) for the accession.version that starts a header
+// line and for each further one, as nr joins the headers of identical sequences with ^A (SOH):
+// "WP_000001.1 protein [Species A]^AWP_000002.1 protein [Species B]"
+template <typename F>
+void for_each_header_accession(const str::View& line, F visit) {
+    const char* p = line.data;
+    const char* end = line.data + line.size;
+    while (true) {
+        const char* q = p;
+        while ((q != end) && (*q != ' ') && (*q != '\x01')) {
+            ++q;
+        }
+        if ((q != p) || (p == line.data)) {
+            const void* dot = memchr(p, '.', q - p);
+            visit(p, dot ? static_cast<const char*>(dot) - p : q - p, q - p);
+        }
+        const void* soh = memchr(q, '\x01', end - q);
+        if (soh == nullptr) break;
+        p = static_cast<const char*>(soh) + 1;
+    }
+}
+
+// collect headers whose '>' lies in [begin, end)
+void scan_headers(const char* data, std::size_t size, std::size_t begin, std::size_t end, std::vector<Header>& headers) {
+    if ((begin == 0) && (end > 0) && (data[0] == '>')) {
+        headers.push_back(parse_header(data, size, 0));
+    }
+    std::size_t i = (begin == 0) ? 0 : begin - 1;  // a newline right before the range may start a record in it
+    while (i + 1 < end) {
+        const void* newline = memchr(data + i, '\n', end - 1 - i);
+        if (newline == nullptr) break;
+        std::size_t pos = static_cast<const char*>(newline) - data + 1;
+        if (data[pos] == '>') {
+            headers.push_back(parse_header(data, size, pos));
+        }
+        i = pos;
+    }
+}
+
+// scan a mapped fasta file from offset for record starts, one byte range per thread;
+// offset must be 0 or the start of a record
+void scan_fasta(const os::MappedFile& in, const std::string& file, unsigned int threads,
+                std::vector<std::vector<Header>>& chunks, std::size_t offset=0) {
+    const char* data = in.data();
+    std::size_t size = in.size();
+    const void* newline = (size > offset) ? memchr(data + offset, '\n', size - offset) : nullptr;
+    std::size_t first_line_length = newline ? static_cast<const char*>(newline) - data - offset : size - offset;
+    if ((first_line_length < 3) || (data[offset] != '>')) {
+        throw std::runtime_error(file + ": Invalid fasta file");
+    }
+    std::size_t n = std::max<std::size_t>(1, std::min<std::size_t>(threads, size - offset));
+    chunks.assign(n, std::vector<Header>());
+    in.advise_sequential();
+    os::Progress progress(file, size - offset);
+    run_parallel(n, [&](std::size_t i) {
+        std::size_t end = offset + (size - offset) * (i + 1) / n;
+        for (std::size_t begin=offset + (size - offset) * i / n; begin<end; begin+=SCAN_SLICE_SIZE) {
+            std::size_t last = std::min(end, begin + SCAN_SLICE_SIZE);
+            scan_headers(data, size, begin, last, chunks[i]);
+            progress.add(last - begin);
+        }
+    });
+}
+
+// scan a gzip fasta file in one pass, visit(line, pos, length) gets the header line of each record
+// and positions in the decompressed stream
+template <typename F>
+void scan_gzip_fasta(const std::string& file, F visit) {
+    bool first = true;
+    bool pending = false;
+    std::string line;  // header of the record whose end is not known yet
+    std::uint64_t pos = 0;
+    std::uint64_t size = 0;
+    std::vector<Header> headers;
+    for_each_gzip_chunk(file, [&](const char* data, std::size_t n, std::uint64_t offset) {
+        if (first) {
+            const void* newline = memchr(data, '\n', n);
+            std::size_t first_line_length = newline ? static_cast<const char*>(newline) - data : n;
+            if ((first_line_length < 3) || (data[0] != '>')) {
+                throw std::runtime_error(file + ": Invalid fasta file");
+            }
+            first = false;
+        }
+        headers.clear();
+        scan_headers(data, n, 0, n, headers);
+        for (const Header& header : headers) {
+            if (pending) {
+                visit(str::View(line.data(), line.size()), pos, offset + header.pos - pos);
+            }
+            str::View view = header_line(data, n, header.pos);
+            line.assign(view.data, view.size);
+            pos = offset + header.pos;
+            pending = true;
+        }
+        size = offset + n;
+    });
+    if (first) {
+        throw std::runtime_error(file + ": Invalid fasta file");
+    }
+    visit(str::View(line.data(), line.size()), pos, size - pos);
+}
+
+// store the block table of a BGZF file next to it (<file>.gzi, as bgzip -i does),
+// so that sequences can be extracted without scanning the whole file; rewritten on every
+// call since the file may have changed since an existing one was made
+void index_bgzf(const std::string& file) {
+    if (os::path::is_bgzf(file)) {
+        std::vector<os::BgzfFile::Block> blocks;
+        os::BgzfFile::scan(file, blocks);
+        os::BgzfFile::save(file + ".gzi", file, blocks);
+    }
+}
+
+// call visit(data, begin, end) on newline-aligned chunks of an accession2taxid file without its header,
+// gzip input is decompressed on another thread while the previous chunk is visited
+template <typename F>
+void for_each_accession_chunk(const std::string& file, F visit) {
+    if (os::path::is_gzip(file)) {
+        bool header = true;
+        for_each_gzip_chunk(file, [&](const char* data, std::size_t size, std::uint64_t) {
+            std::size_t begin = 0;
+            if (header) {  // omit header
+                const void* newline = memchr(data, '\n', size);
+                begin = newline ? static_cast<const char*>(newline) - data + 1 : size;
+                header = false;
+            }
+            visit(data, begin, size);
+        });
+        return;
+    }
+
+    os::MappedFile in(file);
+    const char* data = in.data();
+
+    // omit header
+    const void* newline = (in.size() > 0) ? memchr(data, '\n', in.size()) : nullptr;
+    if (newline == nullptr) {
+        return;
+    }
+    in.advise_sequential();
+    os::Progress progress(file, in.size());
+    std::size_t begin = static_cast<const char*>(newline) - data + 1;
+    while (begin < in.size()) {
+        // newline-aligned slices, each visited with all threads
+        std::size_t end = std::min(in.size(), begin + SCAN_SLICE_SIZE);
+        const void* eol = (end < in.size()) ? memchr(data + end, '\n', in.size() - end) : nullptr;
+        end = eol ? static_cast<const char*>(eol) - data + 1 : in.size();
+        visit(data, begin, end);
+        progress.set(end);
+        begin = end;
+    }
+}
+
+// taxids in the subtrees of some nodes, one bit per taxid
+class TaxidBitmap {
+public:
+    TaxidBitmap(const Taxonomy& taxonomy, const std::vector<Node>& nodes) {
+        for (const Node& node : nodes) {
+            for (std::uint32_t i=node.index(); i<node.end(); ++i) {
+                std::uint32_t taxid = taxonomy.at(i).taxid();
+                if ((taxid >> 6) >= bits_.size()) {
+                    bits_.resize((taxid >> 6) + 1, 0);
+                }
+                bits_[taxid >> 6] |= std::uint64_t(1) << (taxid & 63);
+            }
+        }
+    }
+    bool contains(std::uint64_t taxid) const {
+        return ((taxid >> 6) < bits_.size()) && ((bits_[taxid >> 6] >> (taxid & 63)) & 1);
+    }
+private:
+    std::vector<std::uint64_t> bits_;
+};
+
+// keep accessions of lines in [begin, end) whose taxid is in the bitmap, parsed in newline-aligned
+// ranges and merged in file order so that the first occurrence wins; accessions that do not pack
+// are added to the table while merging; returns the number of lines
+std::uint64_t parse_accession_lines(
+    const char* data,
+    std::size_t begin,
+    std::size_t end,
+    unsigned int threads,
+    const TaxidBitmap& taxids,
+    AccessionTable& accession_table,
+    std::unordered_map<Accession, std::uint32_t>& accession2taxid
+) {
+    std::vector<std::size_t> bounds;
+    split_lines(data, begin, end, threads, bounds);
+    std::size_t n = bounds.size() - 1;
+    std::vector<std::unordered_map<Accession, std::uint32_t>> results(n);
+    std::vector<std::vector<std::pair<std::string, std::uint32_t>>> others(n);
+    std::vector<std::uint64_t> lines(n, 0);
+    run_parallel(n, [&](std::size_t i) {
+        std::unordered_map<Accession, std::uint32_t>& result = results[i];
+        Accession accession;
+        std::uint64_t taxid = 0;
+        std::uint64_t count = 0;
+        for_each_line(data, bounds[i], bounds[i+1], [&](const char* first, const char* last) {
+            ++count;
+            // accession, accession.version, taxid, gi; only the taxid is parsed unless it is a hit
+            const char* tab1 = static_cast<const char*>(memchr(first, '\t', last - first));
+            if (tab1 == nullptr) return;
+            const char* tab2 = static_cast<const char*>(memchr(tab1 + 1, '\t', last - tab1 - 1));
+            if (tab2 == nullptr) return;
+            const char* tab3 = static_cast<const char*>(memchr(tab2 + 1, '\t', last - tab2 - 1));
+            if (tab3 == nullptr) return;
+            if ((! str::to_uint(str::View(tab2 + 1, tab3 - tab2 - 1), taxid)) || (! taxids.contains(taxid))) return;
+            if (memchr(tab3 + 1, '\t', last - tab3 - 1) != nullptr) return;  // more than 4 columns
+            if (Accession::pack(first, tab1 - first, accession)) {
+                result.emplace(accession, taxid);
+            } else {
+                others[i].emplace_back(std::string(first, tab1 - first), taxid);
+            }
+        });
+        lines[i] = count;
+    });
+    std::uint64_t total = 0;
+    for (std::size_t i=0; i<n; ++i) {
+        if (accession2taxid.empty()) {
+            accession2taxid.swap(results[i]);
+        } else {
+            accession2taxid.insert(results[i].begin(), results[i].end());
+        }
+        for (const std::pair<std::string, std::uint32_t>& other : others[i]) {
+            accession2taxid.emplace(Accession(other.first, accession_table), other.second);
+        }
+        total += lines[i];
+    }
+    return total;
+}
+
+// stitch scanned chunks in file order, each record ends where the next one begins
+template <typename F>
+void for_each_record(const std::vector<std::vector<Header>>& chunks, std::size_t size, F visit) {
+    const Header* prev = nullptr;
+    for (const std::vector<Header>& chunk : chunks) {
+        for (const Header& header : chunk) {
+            if (prev != nullptr) {
+                visit(*prev, header.pos - prev->pos);
+            }
+            prev = &header;
+        }
+    }
+    if (prev != nullptr) {
+        visit(*prev, size - prev->pos);
+    }
+}
+
+// identifies the version of a source file without reading all of it
+struct FileStamp {
+    std::uint64_t size;
+    std::int64_t mtime;
+    std::uint64_t fingerprint;
+
+    void assign(const std::string& file) {
+        size = os::path::size(file);
+        mtime = os::path::mtime(file);
+        fingerprint = os::path::fingerprint(file);
+    }
+    bool matches(const std::string& file) const {
+        return (size == os::path::size(file))
+            && (mtime == os::path::mtime(file))
+            && (fingerprint == os::path::fingerprint(file));
+    }
+    // file still begins with the bytes this stamp was taken from, e.g. after an append
+    bool prefix_of(const std::string& file) const {
+        return (size <= os::path::size(file)) && (fingerprint == os::path::fingerprint(file, size));
+    }
+};
+
+// binary index layout (native byte order):
+//   IndexHeader
+//   IndexRecord[records]  sequence locations in file order
+//   IndexKey[keys]        accessions sorted bytewise, pointing into the pool; the accessions of
+//                         a multi-accession header share one record
+//   char[pool_size]       accession.version strings
+static const char INDEX_MAGIC[8] = {'S', 'U', 'B', 'N', 'X', 'I', 'D', 'X'};
+static const std::uint32_t INDEX_VERSION = 3;  // 3: every accession of multi-accession headers
+
+struct IndexHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t reserved;
+    FileStamp source;  // the sequences file when it was indexed
+    std::uint64_t records;
+    std::uint64_t keys;
+    std::uint64_t pool_size;
+};
+
+struct IndexRecord {
+    std::uint64_t pos;
+    std::uint64_t length;
+};
+
+struct IndexKey {
+    std::uint64_t offset;
+    std::uint32_t accession_length;
+    std::uint32_t version_length;
+    std::uint64_t record;
+};
+
+int compare_key(const char* pool, const IndexKey& key, const char* accession, std::size_t length) {
+    std::size_t n = std::min<std::size_t>(key.accession_length, length);
+    int cmp = memcmp(pool + key.offset, accession, n);
+    if (cmp != 0) return cmp;
+    if (key.accession_length == length) return 0;
+    return (key.accession_length < length) ? -1 : 1;
+}
+
+class IndexReader;
+
+// collects records and writes a sorted binary index
+class IndexWriter {
+public:
+    IndexWriter() : sorted_(0) {}
+
+    void add(const char* version, std::size_t accession_length, std::size_t version_length,
+             std::uint64_t pos, std::uint64_t length) {
+        IndexKey key;
+        key.offset = pool_.size();
+        key.accession_length = accession_length;
+        key.version_length = version_length;
+        key.record = records_.size();
+        keys_.push_back(key);
+        pool_.append(version, version_length);
+        IndexRecord record;
+        record.pos = pos;
+        record.length = length;
+        records_.push_back(record);
+    }
+    // another accession of the last record added, stored as a key only
+    void alias(const char* version, std::size_t accession_length, std::size_t version_length) {
+        IndexKey key;
+        key.offset = pool_.size();
+        key.accession_length = accession_length;
+        key.version_length = version_length;
+        key.record = records_.size() - 1;
+        keys_.push_back(key);
+        pool_.append(version, version_length);
+    }
+    // a record with every accession of its header line
+    void add(const str::View& line, std::uint64_t pos, std::uint64_t length) {
+        bool first = true;
+        for_each_header_accession(line, [&](const char* version, std::size_t accession_length, std::size_t version_length) {
+            if (first) {
+                add(version, accession_length, version_length, pos, length);
+                first = false;
+            } else {
+                alias(version, accession_length, version_length);
+            }
+        });
+    }
+
+    // start from the first records of an existing index, their keys are sorted already
+    void append(const IndexReader& index, std::size_t records);
+
+    // replaces outfile atomically, so that outfile may be the index being appended to
+    void write(const std::string& outfile, const FileStamp& source) {
+        const char* pool = pool_.data();
+        auto less = [pool](const IndexKey& a, const IndexKey& b) {
+            return compare_key(pool, a, pool + b.offset, b.accession_length) < 0;
+        };
+        std::stable_sort(keys_.begin() + sorted_, keys_.end(), less);
+        std::inplace_merge(keys_.begin(), keys_.begin() + sorted_, keys_.end(), less);
+        os::AtomicFile atomic(outfile);
+        std::ofstream& out = atomic.stream();
+        IndexHeader header;
+        memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+        header.version = INDEX_VERSION;
+        header.reserved = 0;
+        header.source = source;
+        header.records = records_.size();
+        header.keys = keys_.size();
+        header.pool_size = pool_.size();
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(records_.data()), records_.size() * sizeof(IndexRecord));
+        out.write(reinterpret_cast<const char*>(keys_.data()), keys_.size() * sizeof(IndexKey));
+        out.write(pool_.data(), pool_.size());
+        atomic.commit();
+    }
+private:
+    std::vector<IndexRecord> records_;
+    std::vector<IndexKey> keys_;
+    std::size_t sorted_;  // keys_[0, sorted_) are in order
+    std::string pool_;
+};
+
+// read-only view of a mapped binary index
+class IndexReader {
+public:
+    explicit IndexReader(const std::string& file) : in_(file) {
+        const IndexHeader* header = reinterpret_cast<const IndexHeader*>(in_.data());
+        if ((in_.size() < sizeof(IndexHeader))
+            || (memcmp(header->magic, INDEX_MAGIC, sizeof(header->magic)) != 0)
+            || (header->version != INDEX_VERSION)
+            || (in_.size() != sizeof(IndexHeader) + header->records * sizeof(IndexRecord)
+                              + header->keys * sizeof(IndexKey) + header->pool_size)) {
+            throw std::runtime_error(file + ": Invalid index file");
+        }
+        source = header->source;
+        records = reinterpret_cast<const IndexRecord*>(in_.data() + sizeof(IndexHeader));
+        keys = reinterpret_cast<const IndexKey*>(records + header->records);
+        pool = reinterpret_cast<const char*>(keys + header->keys);
+        nrecords = header->records;
+        nkeys = header->keys;
+    }
+public:
+    FileStamp source;
+    const IndexRecord* records;
+    const IndexKey* keys;
+    const char* pool;
+    std::size_t nrecords;
+    std::size_t nkeys;
+private:
+    os::MappedFile in_;
+};
+
+void IndexWriter::append(const IndexReader& index, std::size_t records) {
+    records_.insert(records_.end(), index.records, index.records + records);
+    for (std::size_t i=0; i<index.nkeys; ++i) {
+        if (index.keys[i].record < records) {
+            keys_.push_back(index.keys[i]);
+        }
+    }
+    sorted_ = keys_.size();
+
+    // the pool keeps the order of the old one, so the accessions of a record stay in header order
+    std::vector<std::size_t> order(keys_.size());
+    for (std::size_t i=0; i<order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b) {
+        return keys_[a].offset < keys_[b].offset;
+    });
+    for (std::size_t i : order) {
+        IndexKey& key = keys_[i];
+        std::uint64_t offset = key.offset;
+        key.offset = pool_.size();
+        pool_.append(index.pool + offset, key.version_length);
+    }
+}
+
+// taxonomy snapshot layout (native byte order): SnapshotHeader, then taxids, parents,
+// children offsets, children, subtree ends, ranks, name offsets, names, taxid lookup, principal-rank
+// ancestors, ordered flags, rank offsets and rank names, each array padded to 8 bytes
+static const char SNAPSHOT_MAGIC[8] = {'S', 'U', 'B', 'N', 'X', 'T', 'A', 'X'};
+static const std::uint32_t SNAPSHOT_VERSION = 3;
+
+struct SnapshotHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t reserved;
+    FileStamp names;
+    FileStamp nodes;
+    std::uint64_t nodes_count;
+    std::uint64_t children_count;
+    std::uint64_t names_size;
+    std::uint64_t lookup_size;
+    std::uint64_t ranks_count;
+};
+
+// dense taxid to node table, NO_NODE for unused taxids
+void index_taxids(const std::vector<std::uint32_t>& taxids, std::vector<std::uint32_t>& lookup) {
+    std::uint32_t max_taxid = 0;
+    for (std::uint32_t taxid : taxids) {
+        max_taxid = std::max(max_taxid, taxid);
+    }
+    lookup.assign(taxids.empty() ? 0 : std::size_t(max_taxid) + 1, NO_NODE);
+    for (std::uint32_t i=0; i<taxids.size(); ++i) {
+        if (lookup[taxids[i]] != NO_NODE) {
+            throw std::runtime_error(std::to_string(taxids[i]) + ": Duplicate taxon ID");
+        }
+        lookup[taxids[i]] = i;
+    }
+}
+
+// children of every node grouped by parent (CSR), in node order
+void group_children(const std::vector<std::uint32_t>& parents, std::vector<std::uint32_t>& offsets, std::vector<std::uint32_t>& children) {
+    std::size_t n = parents.size();
+    offsets.assign(n + 1, 0);
+    for (std::size_t i=0; i<n; ++i) {
+        if (parents[i] != NO_NODE) {
+            ++offsets[parents[i] + 1];
+        }
+    }
+    for (std::size_t i=0; i<n; ++i) {
+        offsets[i+1] += offsets[i];
+    }
+    children.assign(offsets[n], 0);
+    std::vector<std::uint32_t> next(offsets.begin(), offsets.end() - 1);
+    for (std::size_t i=0; i<n; ++i) {
+        if (parents[i] != NO_NODE) {
+            children[next[parents[i]]++] = i;
+        }
+    }
+}
+
+// slot of a principal rank from the top down, NO_PRINCIPAL if not principal
+std::uint8_t principal_slot(const std::string& rank) {
+    auto it = std::find(PRINCIPALS.begin(), PRINCIPALS.end(), rank);
+    return (it != PRINCIPALS.end()) ? it - PRINCIPALS.begin() : NO_PRINCIPAL;
+}
+
+template <typename T>
+void write_aligned(std::ofstream& out, const T* data, std::size_t n) {
+    static const char PADDING[8] = {0};
+    std::size_t bytes = n * sizeof(T);
+    out.write(reinterpret_cast<const char*>(data), bytes);
+    out.write(PADDING, (8 - bytes % 8) % 8);
+}
+
+// walks the arrays of a mapped snapshot, checking bounds
+class SnapshotReader {
+public:
+    SnapshotReader(const char* begin, const char* end) : p_(begin), end_(end) {}
+
+    template <typename T>
+    bool read(Array<T>& array, std::size_t n) {
+        const T* data = next<T>(n);
+        if ((data == nullptr) && (n > 0)) return false;
+        array.view(data, n);
+        return true;
+    }
+    template <typename T>
+    bool copy(std::vector<T>& values, std::size_t n) {
+        const T* data = next<T>(n);
+        if ((data == nullptr) && (n > 0)) return false;
+        values.assign(data, data + n);
+        return true;
+    }
+private:
+    template <typename T>
+    const T* next(std::size_t n) {
+        std::size_t bytes = n * sizeof(T);
+        std::size_t padded = bytes + (8 - bytes % 8) % 8;
+        if ((n == 0) || (std::size_t(end_ - p_) < padded)) return nullptr;
+        const T* data = reinterpret_cast<const T*>(p_);
+        p_ += padded;
+        return data;
+    }
+private:
+    const char* p_;
+    const char* end_;
+};
+
+// accession2taxid table layout (native byte order):
+//   TableHeader
+//   TableGroup[groups]          taxids in ascending order, each owning postings [first, next first)
+//   uint64_t[postings + 1]      accession offsets into the pool, in posting order
+//   char[pool_size]             accessions
+static const char TABLE_MAGIC[8] = {'S', 'U', 'B', 'N', 'X', 'A', '2', 'T'};
+static const std::uint32_t TABLE_VERSION = 1;
+
+struct TableHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t reserved;
+    FileStamp source;
+    std::uint64_t groups;
+    std::uint64_t postings;
+    std::uint64_t pool_size;
+};
+
+struct TableGroup {
+    std::uint32_t taxid;
+    std::uint32_t reserved;
+    std::uint64_t first;
+};
+
+// an accession2taxid row while building the table, the accession lives in a pool
+struct TableRow {
+    std::uint64_t offset;
+    std::uint32_t length;
+    std::uint32_t taxid;
+};
+
+// collect all rows of an accession2taxid file in file order, each range is parsed into its own pool
+// and appended afterwards
+void collect_table_rows(const std::string& file, unsigned int threads, std::vector<TableRow>& rows, std::string& pool) {
+    for_each_accession_chunk(file, [&](const char* data, std::size_t begin, std::size_t end) {
+        std::vector<std::size_t> bounds;
+        split_lines(data, begin, end, threads, bounds);
+        std::size_t n = bounds.size() - 1;
+        std::vector<std::vector<TableRow>> chunk_rows(n);
+        std::vector<std::string> chunk_pools(n);
+        run_parallel(n, [&](std::size_t i) {
+            std::uint64_t taxid = 0;
+            str::Fields<4, 3> row("\t");
+            for_each_line(data, bounds[i], bounds[i+1], [&](const char* first, const char* last) {
+                if ((! row.split(first, last)) || (! str::to_uint(row[2], taxid)) || (taxid > UINT32_MAX)) return;
+                TableRow entry;
+                entry.offset = chunk_pools[i].size();
+                entry.length = row[0].size;
+                entry.taxid = taxid;
+                chunk_rows[i].push_back(entry);
+                chunk_pools[i].append(row[0].data, row[0].size);
+            });
+        });
+        for (std::size_t i=0; i<n; ++i) {
+            for (TableRow& entry : chunk_rows[i]) {
+                entry.offset += pool.size();
+                rows.push_back(entry);
+            }
+            pool += chunk_pools[i];
+        }
+    });
+}
+
+// database layout (native byte order):
+//   DatabaseHeader
+//   uint64_t[nodes + 1]         first entry of each node in taxonomy pre-order
+//   DatabaseEntry[entries]      sequences of each node, ordered by position
+//   char[pool_size]             accession.version strings
+static const char DATABASE_MAGIC[8] = {'S', 'U', 'B', 'N', 'X', 'D', 'B', '\0'};
+static const std::uint32_t DATABASE_VERSION = 2;  // 2: built from indexes with header aliases
+
+struct DatabaseHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t reserved;
+    FileStamp names;
+    FileStamp nodes;
+    FileStamp accession2taxid;
+    FileStamp sequences;
+    std::uint64_t nodes_count;
+    std::uint64_t entries;
+    std::uint64_t pool_size;
+};
+
+struct DatabaseEntry {
+    std::uint64_t pos;
+    std::uint64_t length;
+    std::uint64_t offset;
+    std::uint32_t accession_length;
+    std::uint32_t version_length;
+};
+
+// description store layout (native byte order):
+//   DescriptionHeader
+//   char[pool_size]                  descriptions in file order
+//   DescriptionEntry[records + 1]    record positions in file order, each owning [offset, next offset)
+static const char DESCRIPTION_MAGIC[8] = {'S', 'U', 'B', 'N', 'X', 'D', 'S', 'C'};
+static const std::uint32_t DESCRIPTION_VERSION = 1;
+
+struct DescriptionHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t reserved;
+    FileStamp source;
+    std::uint64_t records;
+    std::uint64_t pool_size;
+};
+
+struct DescriptionEntry {
+    std::uint64_t pos;
+    std::uint64_t offset;
+};
+
+// the text after the accession.version of a header up to the end of its line
+str::View parse_description(const char* data, std::size_t size, const Header& header) {
+    const char* begin = data + header.pos + 1 + header.version_length;
+    const char* end = data + size;
+    if ((begin != end) && (*begin == ' ')) {
+        ++begin;
+    }
+    const void* newline = memchr(begin, '\n', end - begin);
+    if (newline != nullptr) {
+        end = static_cast<const char*>(newline);
+    }
+    if ((end != begin) && (*(end - 1) == '\r')) {
+        --end;
+    }
+    return str::View(begin, end - begin);
+}
+
+// streams descriptions to a temporary file, only the record positions are kept in memory
+class DescriptionWriter {
+public:
+    explicit DescriptionWriter(const std::string& outfile)
+        : atomic_(outfile), out_(atomic_.stream()), pool_size_(0) {
+        DescriptionHeader header;
+        memset(&header, 0, sizeof(header));
+        out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+    void add(std::uint64_t pos, const str::View& description) {
+        entries_.push_back(DescriptionEntry{pos, pool_size_});
+        out_.write(description.data, description.size);
+        pool_size_ += description.size;
+    }
+    // the store replaces outfile only now, concurrent readers never see a partial one
+    void write(const FileStamp& source) {
+        DescriptionHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, DESCRIPTION_MAGIC, sizeof(header.magic));
+        header.version = DESCRIPTION_VERSION;
+        header.source = source;
+        header.records = entries_.size();
+        header.pool_size = pool_size_;
+        entries_.push_back(DescriptionEntry{UINT64_MAX, pool_size_});
+        out_.write(reinterpret_cast<const char*>(entries_.data()), entries_.size() * sizeof(DescriptionEntry));
+        out_.seekp(0);
+        out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        atomic_.commit();
+    }
+private:
+    os::AtomicFile atomic_;
+    std::ofstream& out_;
+    std::vector<DescriptionEntry> entries_;
+    std::uint64_t pool_size_;
+};
+
+// packed accession key: 0, a 4-bit format and a 59-bit payload holding the letters in base 26
+// followed by the digits; other accessions are the address of their copy in an AccessionTable
+// with the top bit set
+struct AccessionFormat {
+    std::uint8_t letters;
+    bool underscore;
+    std::uint8_t digits;
+};
+
+static const std::vector<AccessionFormat> ACCESSION_FORMATS = {
+    {1, false, 5}, {2, false, 6}, {2, false, 8},                     // GenBank nucleotide
+    {3, false, 5}, {3, false, 7},                                    // protein
+    {4, false, 8}, {4, false, 9}, {4, false, 10}, {6, false, 9},     // WGS and TSA
+    {5, false, 7},                                                   // MGA
+    {2, true, 6}, {2, true, 8}, {2, true, 9}                         // RefSeq
+};
+static const std::size_t ACCESSION_PAYLOAD_BITS = 59;
+static const std::uint64_t SIDE_ACCESSION = std::uint64_t(1) << 63;
+
+// finds index keys among a set of accessions without the table they were added to: packed keys
+// directly, the others by name among the accessions of the set that do not pack
+class AccessionMatcher {
+public:
+    explicit AccessionMatcher(const std::unordered_set<Accession>& accessions) : accessions_(accessions) {
+        for (const Accession& accession : accessions) {
+            if (! accession.packed()) {
+                others_.emplace(accession.str(), accession);
+            }
+        }
+    }
+    bool find(const char* data, std::size_t size, Accession& accession) const {
+        if (Accession::pack(data, size, accession)) {
+            return accessions_.find(accession) != accessions_.end();
+        }
+        if (others_.empty()) {
+            return false;
+        }
+        auto it = others_.find(std::string(data, size));
+        if (it == others_.end()) {
+            return false;
+        }
+        accession = it->second;
+        return true;
+    }
+private:
+    const std::unordered_set<Accession>& accessions_;
+    std::unordered_map<std::string, Accession> others_;
+};
+
+// taxids of the pre-order ranges of the nodes, sorted and unique
+void collect_taxids(const Taxonomy& taxonomy, const std::vector<Node>& nodes, std::vector<std::uint32_t>& taxids) {
+    for (const Node& node : nodes) {
+        for (std::uint32_t i=node.index(); i<node.end(); ++i) {
+            taxids.push_back(taxonomy.at(i).taxid());
+        }
+    }
+    std::sort(taxids.begin(), taxids.end());
+    taxids.erase(std::unique(taxids.begin(), taxids.end()), taxids.end());
+}
+
+} // namespace
+
+void NameIO::parse(const std::string& file, std::unordered_map<std::uint32_t, std::string>& names) {
+    std::ifstream in(file);
+    if (! in) {
+        throw std::runtime_error(file + ": Failed to open file");
+    }
+    std::string line;
+    std::uint64_t taxid = 0;
+    str::Fields<4> row("\t|\t");
+    while (std::getline(in, line)) {
+        if (row.split(line) && is_scientific_name(row[3]) && str::to_uint(row[0], taxid)) {
+            names.emplace(taxid, row[1].str());
+        }
+    }
+    in.close();
+}
+
+bool NameIO::is_scientific_name(const str::View& name) {
+    return name.startswith("scientific name");
+}
+
+Node::Node() : tree_(nullptr), index_(NO_NODE) {}
+
+Node::Node(const Taxonomy* tree, std::uint32_t index) : tree_(tree), index_(index) {}
+
+bool Node::valid() const {
+    return (tree_ != nullptr) && (index_ != NO_NODE);
+}
+
+std::uint32_t Node::index() const {
+    return index_;
+}
+
+std::uint32_t Node::taxid() const {
+    return tree_->taxids_[index_];
+}
+
+std::string Node::name() const {
+    std::uint32_t begin = tree_->name_offsets_[index_];
+    std::uint32_t end = tree_->name_offsets_[index_+1];
+    return std::string(tree_->names_.data() + begin, end - begin);
+}
+
+const std::string& Node::rank() const {
+    return tree_->rank_names_[tree_->ranks_[index_]];
+}
+
+Node Node::parent() const {
+    return Node(tree_, tree_->parents_[index_]);
+}
+
+std::size_t Node::degree() const {
+    return tree_->offsets_[index_+1] - tree_->offsets_[index_];
+}
+
+Node Node::child(std::size_t i) const {
+    return Node(tree_, tree_->children_[tree_->offsets_[index_] + i]);
+}
+
+bool Node::is_root() const {
+    return tree_->parents_[index_] == NO_NODE;
+}
+
+void Node::trace(std::vector<Node>& ancestors) const {
+    for (std::uint32_t i=index_; i!=NO_NODE; i=tree_->parents_[i]) {
+        ancestors.emplace_back(tree_, i);
+    }
+}
+
+void Node::expand(std::vector<Node>& descendants) const {
+    // the subtree is the pre-order range [index, end)
+    for (std::uint32_t i=index_; i<end(); ++i) {
+        descendants.emplace_back(tree_, i);
+    }
+}
+
+std::uint32_t Node::end() const {
+    return tree_->ends_[index_];
+}
+
+bool Node::contains(const Node& other) const {
+    return (tree_ == other.tree_) && (index_ <= other.index_) && (other.index_ < end());
+}
+
+bool Node::is_principal() const {
+    return tree_->principals_[tree_->ranks_[index_]] != NO_PRINCIPAL;
+}
+
+Node Node::principal(std::size_t slot) const {
+    return Node(tree_, tree_->ancestors_[index_ * PRINCIPALS.size() + slot]);
+}
+
+std::string Node::str(bool abbr) const {
+    std::string str;
+    if (abbr && is_principal()) {
+        str = rank()[0] + RANK_DELIMITER + name();
+    } else {
+        str = rank() + RANK_DELIMITER + name();
+    }
+    str::replace(str, " ", "_");
+    return str;
+}
+
+std::string Node::lineage(bool principal) const {
+    std::string lineage;
+    if (principal && tree_->ordered_[index_]) {
+        for (std::size_t slot=0; slot<PRINCIPALS.size(); ++slot) {
+            Node ancestor = this->principal(slot);
+            if (! ancestor.valid()) {
+                continue;
+            }
+            if (! lineage.empty()) {
+                lineage += "; ";
+            }
+            lineage += ancestor.str(true);
+        }
+        return lineage;
+    }
+
+    std::vector<Node> ancestors;
+    trace(ancestors);
+    for (auto it=ancestors.rbegin(); it!=ancestors.rend(); ++it) {
+        if (principal && (! it->is_principal())) {
+            continue;
+        }
+        if (! lineage.empty()) {
+            lineage += "; ";
+        }
+        lineage += it->str(principal);
+    }
+    return lineage;
+}
+
+bool Node::operator==(const Node& other) const {
+    return (tree_ == other.tree_) && (index_ == other.index_);
+}
+
+bool Node::operator!=(const Node& other) const {
+    return ! (*this == other);
+}
+
+Taxonomy::Taxonomy() {
+    pending_.name_offsets.push_back(0);
+}
+
+std::uint16_t Taxonomy::rank_code(const std::string& rank) {
+    auto it = pending_.rank_codes.find(rank);
+    if (it != pending_.rank_codes.end()) {
+        return it->second;
+    }
+    if (rank_names_.size() > UINT16_MAX) {
+        throw std::runtime_error(rank + ": Too many ranks");
+    }
+    pending_.rank_codes.emplace(rank, rank_names_.size());
+    rank_names_.push_back(rank);
+    principals_.push_back(principal_slot(rank));
+    return rank_names_.size() - 1;
+}
+
+void Taxonomy::add(std::uint32_t taxid, std::uint32_t parent, const std::string& name, const std::string& rank) {
+    if (pending_.names.size() + name.size() > UINT32_MAX) {
+        throw std::runtime_error("Too many taxon names");
+    }
+    pending_.taxids.push_back(taxid);
+    pending_.parents.push_back(parent);  // a taxid until build()
+    pending_.ranks.push_back(rank_code(rank));
+    pending_.names.insert(pending_.names.end(), name.begin(), name.end());
+    pending_.name_offsets.push_back(pending_.names.size());
+}
+
+void Taxonomy::build() {
+    std::vector<std::uint32_t>& taxids = pending_.taxids;
+    std::vector<std::uint32_t>& parents = pending_.parents;
+    std::uint32_t n = taxids.size();
+    std::vector<std::uint32_t> lookup;
+    index_taxids(taxids, lookup);
+
+    // resolve parent taxids, the root is its own parent in nodes.dmp
+    for (std::uint32_t i=0; i<n; ++i) {
+        std::uint32_t parent = parents[i];
+        if (parent == taxids[i]) {
+            parents[i] = NO_NODE;
+        } else if ((parent < lookup.size()) && (lookup[parent] != NO_NODE)) {
+            parents[i] = lookup[parent];
+        } else {
+            throw std::runtime_error(std::to_string(parent) + ": Parent taxon ID not found");
+        }
+    }
+
+    // renumber nodes in depth-first pre-order so that every subtree is a contiguous range
+    std::vector<std::uint32_t> offsets;
+    std::vector<std::uint32_t> children;
+    group_children(parents, offsets, children);
+    std::vector<std::uint32_t> order;  // new node to old node
+    order.reserve(n);
+    std::vector<std::uint32_t> stack;
+    for (std::uint32_t root=0; root<n; ++root) {
+        if (parents[root] != NO_NODE) continue;
+        stack.push_back(root);
+        while (! stack.empty()) {
+            std::uint32_t i = stack.back();
+            stack.pop_back();
+            order.push_back(i);
+            for (std::uint32_t j=offsets[i+1]; j>offsets[i]; --j) {
+                stack.push_back(children[j-1]);
+            }
+        }
+    }
+    if (order.size() != n) {
+        throw std::runtime_error("Taxonomy contains a cycle");
+    }
+    std::vector<std::uint32_t> renumber(n);  // old node to new node
+    for (std::uint32_t i=0; i<n; ++i) {
+        renumber[order[i]] = i;
+    }
+    std::vector<std::uint32_t> new_taxids(n);
+    std::vector<std::uint32_t> new_parents(n);
+    std::vector<std::uint16_t> ranks(n);
+    std::vector<std::uint32_t> name_offsets(std::size_t(n) + 1, 0);
+    std::vector<char> names;
+    names.reserve(pending_.names.size());
+    for (std::uint32_t i=0; i<n; ++i) {
+        std::uint32_t old = order[i];
+        new_taxids[i] = taxids[old];
+        new_parents[i] = (parents[old] == NO_NODE) ? NO_NODE : renumber[parents[old]];
+        ranks[i] = pending_.ranks[old];
+        names.insert(names.end(),
+                     pending_.names.begin() + pending_.name_offsets[old],
+                     pending_.names.begin() + pending_.name_offsets[old+1]);
+        name_offsets[i+1] = names.size();
+    }
+    index_taxids(new_taxids, lookup);
+    group_children(new_parents, offsets, children);
+
+    // a subtree ends where the last subtree of its children ends
+    std::vector<std::uint32_t> ends(n);
+    for (std::uint32_t i=0; i<n; ++i) {
+        ends[i] = i + 1;
+    }
+    for (std::uint32_t i=n; i>0; --i) {
+        std::uint32_t parent = new_parents[i-1];
+        if (parent != NO_NODE) {
+            ends[parent] = std::max(ends[parent], ends[i-1]);
+        }
+    }
+
+    // nearest principal-rank ancestors, parents always precede their children
+    std::size_t slots = PRINCIPALS.size();
+    std::vector<std::uint32_t> ancestors(std::size_t(n) * slots, NO_NODE);
+    std::vector<std::uint8_t> ordered(n, 0);
+    for (std::uint32_t i=0; i<n; ++i) {
+        std::uint32_t parent = new_parents[i];
+        bool in_order = true;
+        if (parent != NO_NODE) {
+            std::copy_n(ancestors.begin() + parent * slots, slots, ancestors.begin() + i * slots);
+            in_order = ordered[parent];
+        }
+        std::uint8_t slot = principals_[ranks[i]];
+        if (slot != NO_PRINCIPAL) {
+            // a repeated or out-of-order principal rank can't be told by the table
+            for (std::size_t j=slot; j<slots; ++j) {
+                in_order = in_order && (ancestors[i * slots + j] == NO_NODE);
+            }
+            ancestors[i * slots + slot] = i;
+        }
+        ordered[i] = in_order;
+    }
+
+    taxids_.assign(std::move(new_taxids));
+    parents_.assign(std::move(new_parents));
+    offsets_.assign(std::move(offsets));
+    children_.assign(std::move(children));
+    ends_.assign(std::move(ends));
+    ranks_.assign(std::move(ranks));
+    name_offsets_.assign(std::move(name_offsets));
+    names_.assign(std::move(names));
+    lookup_.assign(std::move(lookup));
+    ancestors_.assign(std::move(ancestors));
+    ordered_.assign(std::move(ordered));
+    pending_ = Pending();
+}
+
+std::size_t Taxonomy::size() const {
+    return taxids_.size();
+}
+
+bool Taxonomy::empty() const {
+    return taxids_.size() == 0;
+}
+
+Node Taxonomy::at(std::uint32_t index) const {
+    return Node(this, index);
+}
+
+Node Taxonomy::find(std::uint32_t taxid) const {
+    if (taxid >= lookup_.size()) {
+        return Node();
+    }
+    return Node(this, lookup_[taxid]);
+}
+
+bool TaxonomyIO::load(
+    const std::string& file,
+    const std::string& names_file,
+    const std::string& nodes_file,
+    Taxonomy& taxonomy
+) {
+    if (! os::path::exists(file)) {
+        return false;
+    }
+    os::MappedFile in(file);
+    if (in.size() < sizeof(SnapshotHeader)) {
+        return false;
+    }
+    const SnapshotHeader* header = reinterpret_cast<const SnapshotHeader*>(in.data());
+    if ((memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0)
+        || (header->version != SNAPSHOT_VERSION)
+        || (! header->names.matches(names_file))
+        || (! header->nodes.matches(nodes_file))) {
+        return false;
+    }
+
+    // the arrays follow the header in the order they were saved
+    Taxonomy loaded;
+    std::size_t n = header->nodes_count;
+    SnapshotReader reader(in.data() + sizeof(SnapshotHeader), in.data() + in.size());
+    std::vector<std::uint32_t> rank_offsets;
+    if (! (reader.read(loaded.taxids_, n)
+           && reader.read(loaded.parents_, n)
+           && reader.read(loaded.offsets_, n + 1)
+           && reader.read(loaded.children_, header->children_count)
+           && reader.read(loaded.ends_, n)
+           && reader.read(loaded.ranks_, n)
+           && reader.read(loaded.name_offsets_, n + 1)
+           && reader.read(loaded.names_, header->names_size)
+           && reader.read(loaded.lookup_, header->lookup_size)
+           && reader.read(loaded.ancestors_, n * PRINCIPALS.size())
+           && reader.read(loaded.ordered_, n)
+           && reader.copy(rank_offsets, header->ranks_count + 1))) {
+        return false;
+    }
+    Array<char> rank_pool;
+    if (! reader.read(rank_pool, rank_offsets.back())) {
+        return false;
+    }
+    for (std::size_t i=0; i<header->ranks_count; ++i) {
+        std::string rank(rank_pool.data() + rank_offsets[i], rank_offsets[i+1] - rank_offsets[i]);
+        loaded.principals_.push_back(principal_slot(rank));
+        loaded.rank_names_.push_back(std::move(rank));
+    }
+    loaded.pending_ = Taxonomy::Pending();
+    loaded.snapshot_ = std::move(in);
+    taxonomy = std::move(loaded);
+    return true;
+}
+
+void TaxonomyIO::save(
+    const std::string& file,
+    const std::string& names_file,
+    const std::string& nodes_file,
+    const Taxonomy& taxonomy
+) {
+    os::AtomicFile atomic(file);
+    std::ofstream& out = atomic.stream();
+    std::vector<std::uint32_t> rank_offsets(1, 0);
+    std::string rank_pool;
+    for (const std::string& rank : taxonomy.rank_names_) {
+        rank_pool += rank;
+        rank_offsets.push_back(rank_pool.size());
+    }
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.names.assign(names_file);
+    header.nodes.assign(nodes_file);
+    header.nodes_count = taxonomy.taxids_.size();
+    header.children_count = taxonomy.children_.size();
+    header.names_size = taxonomy.names_.size();
+    header.lookup_size = taxonomy.lookup_.size();
+    header.ranks_count = taxonomy.rank_names_.size();
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    write_aligned(out, taxonomy.taxids_.data(), taxonomy.taxids_.size());
+    write_aligned(out, taxonomy.parents_.data(), taxonomy.parents_.size());
+    write_aligned(out, taxonomy.offsets_.data(), taxonomy.offsets_.size());
+    write_aligned(out, taxonomy.children_.data(), taxonomy.children_.size());
+    write_aligned(out, taxonomy.ends_.data(), taxonomy.ends_.size());
+    write_aligned(out, taxonomy.ranks_.data(), taxonomy.ranks_.size());
+    write_aligned(out, taxonomy.name_offsets_.data(), taxonomy.name_offsets_.size());
+    write_aligned(out, taxonomy.names_.data(), taxonomy.names_.size());
+    write_aligned(out, taxonomy.lookup_.data(), taxonomy.lookup_.size());
+    write_aligned(out, taxonomy.ancestors_.data(), taxonomy.ancestors_.size());
+    write_aligned(out, taxonomy.ordered_.data(), taxonomy.ordered_.size());
+    write_aligned(out, rank_offsets.data(), rank_offsets.size());
+    write_aligned(out, rank_pool.data(), rank_pool.size());
+    atomic.commit();
+}
+
+void NodeIO::parse(
+    const std::string& file,
+    const std::unordered_map<std::uint32_t, std::string>& names,
+    Taxonomy& taxonomy
+) {
+    std::ifstream in(file);
+    if (! in) {
+        throw std::runtime_error(file + ": Failed to open file");
+    }
+    std::string line;
+    std::string rank;
+    std::uint64_t taxid = 0;
+    std::uint64_t parent = 0;
+    str::Fields<13, 3> row("\t|\t");  // only tax_id, parent tax_id and rank are used
+    while (std::getline(in, line)) {
+        if ((! row.split(line)) || (! str::to_uint(row[0], taxid)) || (! str::to_uint(row[1], parent))) {
+            continue;  // omit malformed line
+        }
+        if ((taxid > UINT32_MAX) || (parent > UINT32_MAX)) {
+            throw std::runtime_error(file + ": Taxon ID out of range");
+        }
+        rank.assign(row[2].data, row[2].size);
+        taxonomy.add(taxid, parent, names.at(taxid), rank);
+    }
+    in.close();
+    taxonomy.build();
+}
+
+std::uint64_t Accession2TaxIdIO::parse(
+    const std::string& file,
+    const Taxonomy& taxonomy,
+    const std::vector<Node>& nodes,
+    AccessionTable& accession_table,
+    std::unordered_map<Accession, std::uint32_t>& accession2taxid,
+    unsigned int threads
+) {
+    TaxidBitmap taxids(taxonomy, nodes);
+    std::uint64_t lines = 0;
+    for_each_accession_chunk(file, [&](const char* data, std::size_t begin, std::size_t end) {
+        lines += parse_accession_lines(data, begin, end, threads, taxids, accession_table, accession2taxid);
+    });
+    return lines;
+}
+
+void Accession2TaxIdTableIO::create(const std::string& infile, const std::string& outfile, unsigned int threads) {
+    std::vector<TableRow> rows;
+    std::string pool;
+    collect_table_rows(infile, threads, rows, pool);
+
+    // group by taxid, keeping file order within a group
+    std::stable_sort(rows.begin(), rows.end(), [](const TableRow& a, const TableRow& b) {
+        return a.taxid < b.taxid;
+    });
+    std::vector<TableGroup> groups;
+    std::vector<std::uint64_t> offsets(1, 0);
+    offsets.reserve(rows.size() + 1);
+    for (std::size_t i=0; i<rows.size(); ++i) {
+        if (groups.empty() || (groups.back().taxid != rows[i].taxid)) {
+            groups.push_back(TableGroup{rows[i].taxid, 0, i});
+        }
+        offsets.push_back(offsets.back() + rows[i].length);
+    }
+
+    os::AtomicFile atomic(outfile);
+    std::ofstream& out = atomic.stream();
+    TableHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TABLE_MAGIC, sizeof(header.magic));
+    header.version = TABLE_VERSION;
+    header.source.assign(infile);
+    header.groups = groups.size();
+    header.postings = rows.size();
+    header.pool_size = pool.size();
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(groups.data()), groups.size() * sizeof(TableGroup));
+    out.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(std::uint64_t));
+    for (const TableRow& entry : rows) {
+        out.write(pool.data() + entry.offset, entry.length);
+    }
+    atomic.commit();
+}
+
+bool Accession2TaxIdTableIO::parse(
+    const std::string& file,
+    const std::string& source_file,
+    const Taxonomy& taxonomy,
+    const std::vector<Node>& nodes,
+    AccessionTable& accession_table,
+    std::unordered_map<Accession, std::uint32_t>& accession2taxid
+) {
+    if (! os::path::exists(file)) {
+        return false;
+    }
+    os::MappedFile in(file);
+    const TableHeader* header = reinterpret_cast<const TableHeader*>(in.data());
+    if ((in.size() < sizeof(TableHeader))
+        || (memcmp(header->magic, TABLE_MAGIC, sizeof(header->magic)) != 0)
+        || (header->version != TABLE_VERSION)
+        || (in.size() != sizeof(TableHeader) + header->groups * sizeof(TableGroup)
+                          + (header->postings + 1) * sizeof(std::uint64_t) + header->pool_size)
+        || (! header->source.matches(source_file))) {
+        return false;
+    }
+    const TableGroup* groups = reinterpret_cast<const TableGroup*>(in.data() + sizeof(TableHeader));
+    const std::uint64_t* offsets = reinterpret_cast<const std::uint64_t*>(groups + header->groups);
+    const char* pool = reinterpret_cast<const char*>(offsets + header->postings + 1);
+
+    // only the postings of the requested taxids are touched, each search resumes where the previous one stopped
+    std::vector<std::uint32_t> taxids;
+    collect_taxids(taxonomy, nodes, taxids);
+    const TableGroup* it = groups;
+    const TableGroup* end = groups + header->groups;
+    for (std::uint32_t taxid : taxids) {
+        it = std::lower_bound(it, end, taxid, [](const TableGroup& group, std::uint32_t value) {
+            return group.taxid < value;
+        });
+        if (it == end) break;
+        if (it->taxid != taxid) continue;
+        std::uint64_t last = (it + 1 == end) ? header->postings : (it + 1)->first;
+        for (std::uint64_t i=it->first; i<last; ++i) {
+            accession2taxid.emplace(Accession(pool + offsets[i], offsets[i+1] - offsets[i], accession_table), taxid);
+        }
+    }
+    return true;
+}
+
+void DatabaseIO::create(
+    const std::string& file,
+    const std::string& names_file,
+    const std::string& nodes_file,
+    const std::string& accession2taxid_file,
+    const std::string& infile,
+    const std::string& index_file,
+    const Taxonomy& taxonomy,
+    unsigned int threads
+) {
+    // sort accession2taxid by accession, the first occurrence wins as in a full scan
+    std::vector<TableRow> rows;
+    std::string names;
+    collect_table_rows(accession2taxid_file, threads, rows, names);
+    const char* accessions = names.data();
+    std::stable_sort(rows.begin(), rows.end(), [accessions](const TableRow& a, const TableRow& b) {
+        int cmp = memcmp(accessions + a.offset, accessions + b.offset, std::min(a.length, b.length));
+        return (cmp < 0) || ((cmp == 0) && (a.length < b.length));
+    });
+
+    // merge join with the index keys, which are sorted the same way
+    IndexReader index(index_file);
+    std::vector<std::pair<std::uint32_t, DatabaseEntry>> entries;  // node index and entry
+    std::string pool;
+    const TableRow* row = rows.data();
+    const TableRow* rows_end = rows.data() + rows.size();
+    for (std::size_t i=0; (i < index.nkeys) && (row != rows_end); ) {
+        const IndexKey& key = index.keys[i];
+        int cmp = compare_key(index.pool, key, accessions + row->offset, row->length);
+        if (cmp < 0) {
+            ++i;
+            continue;
+        }
+        if (cmp > 0) {
+            ++row;
+            continue;
+        }
+        Node node = taxonomy.find(row->taxid);
+        if (node.valid()) {
+            const IndexRecord& record = index.records[key.record];
+            DatabaseEntry entry;
+            entry.pos = record.pos;
+            entry.length = record.length;
+            entry.offset = pool.size();
+            entry.accession_length = key.accession_length;
+            entry.version_length = key.version_length;
+            pool.append(index.pool + key.offset, key.version_length);
+            entries.emplace_back(node.index(), entry);
+        }
+        ++i;  // the same accession may occur again in the sequences file
+        if ((i == index.nkeys) || (compare_key(index.pool, index.keys[i], accessions + row->offset, row->length) != 0)) {
+            // skip later duplicates of this accession
+            const TableRow* next = row + 1;
+            while ((next != rows_end) && (next->length == row->length)
+                   && (memcmp(accessions + next->offset, accessions + row->offset, row->length) == 0)) {
+                ++next;
+            }
+            row = next;
+        }
+    }
+
+    // group by node in pre-order, by position within a node
+    std::sort(entries.begin(), entries.end(), [](const std::pair<std::uint32_t, DatabaseEntry>& a,
+                                                 const std::pair<std::uint32_t, DatabaseEntry>& b) {
+        return (a.first < b.first) || ((a.first == b.first) && (a.second.pos < b.second.pos));
+    });
+    std::vector<std::uint64_t> offsets(taxonomy.size() + 1, 0);
+    for (const std::pair<std::uint32_t, DatabaseEntry>& entry : entries) {
+        ++offsets[entry.first + 1];
+    }
+    for (std::size_t i=1; i<offsets.size(); ++i) {
+        offsets[i] += offsets[i-1];
+    }
+
+    os::AtomicFile atomic(file);
+    std::ofstream& out = atomic.stream();
+    DatabaseHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DATABASE_MAGIC, sizeof(header.magic));
+    header.version = DATABASE_VERSION;
+    header.names.assign(names_file);
+    header.nodes.assign(nodes_file);
+    header.accession2taxid.assign(accession2taxid_file);
+    header.sequences.assign(infile);
+    header.nodes_count = taxonomy.size();
+    header.entries = entries.size();
+    header.pool_size = pool.size();
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(std::uint64_t));
+    for (const std::pair<std::uint32_t, DatabaseEntry>& entry : entries) {
+        out.write(reinterpret_cast<const char*>(&entry.second), sizeof(DatabaseEntry));
+    }
+    out.write(pool.data(), pool.size());
+    atomic.commit();
+}
+
+bool DatabaseIO::parse(
+    const std::string& file,
+    const std::string& names_file,
+    const std::string& nodes_file,
+    const std::string& accession2taxid_file,
+    const std::string& infile,
+    const Taxonomy& taxonomy,
+    const std::vector<Node>& nodes,
+    AccessionTable& accession_table,
+    std::unordered_map<Accession, std::uint32_t>& accession2taxid,
+    std::vector<Index>& indexes
+) {
+    Database database;
+    if (! database.load(file, names_file, nodes_file, accession2taxid_file, infile, taxonomy)) {
+        return false;
+    }
+    database.parse(taxonomy, nodes, accession_table, accession2taxid, indexes);
+    return true;
+}
+
+Database::Database() {}
+
+bool Database::load(
+    const std::string& file,
+    const std::string& names_file,
+    const std::string& nodes_file,
+    const std::string& accession2taxid_file,
+    const std::string& infile,
+    const Taxonomy& taxonomy
+) {
+    if (! os::path::exists(file)) {
+        return false;
+    }
+    os::MappedFile in(file);
+    const DatabaseHeader* header = reinterpret_cast<const DatabaseHeader*>(in.data());
+    if ((in.size() < sizeof(DatabaseHeader))
+        || (memcmp(header->magic, DATABASE_MAGIC, sizeof(header->magic)) != 0)
+        || (header->version != DATABASE_VERSION)
+        || (header->nodes_count != taxonomy.size())
+        || (in.size() != sizeof(DatabaseHeader) + (header->nodes_count + 1) * sizeof(std::uint64_t)
+                          + header->entries * sizeof(DatabaseEntry) + header->pool_size)
+        || (! header->names.matches(names_file))
+        || (! header->nodes.matches(nodes_file))
+        || (! header->accession2taxid.matches(accession2taxid_file))
+        || (! header->sequences.matches(infile))) {
+        return false;
+    }
+    file_ = std::move(in);
+    return true;
+}
+
+void Database::parse(
+    const Taxonomy& taxonomy,
+    const std::vector<Node>& nodes,
+    AccessionTable& accession_table,
+    std::unordered_map<Accession, std::uint32_t>& accession2taxid,
+    std::vector<Index>& indexes
+) const {
+    const DatabaseHeader* header = reinterpret_cast<const DatabaseHeader*>(file_.data());
+    const std::uint64_t* offsets = reinterpret_cast<const std::uint64_t*>(file_.data() + sizeof(DatabaseHeader));
+    const DatabaseEntry* entries = reinterpret_cast<const DatabaseEntry*>(offsets + header->nodes_count + 1);
+    const char* pool = reinterpret_cast<const char*>(entries + header->entries);
+
+    // a subtree is one contiguous range of entries, nested or repeated subtrees are read once
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> ranges;
+    for (const Node& node : nodes) {
+        ranges.emplace_back(node.index(), node.end());
+    }
+    std::sort(ranges.begin(), ranges.end());
+    std::uint32_t covered = 0;
+    for (const std::pair<std::uint32_t, std::uint32_t>& range : ranges) {
+        for (std::uint32_t i=std::max(range.first, covered); i<range.second; ++i) {
+            std::uint32_t taxid = taxonomy.at(i).taxid();
+            for (std::uint64_t j=offsets[i]; j<offsets[i+1]; ++j) {
+                const DatabaseEntry& entry = entries[j];
+                Accession accession(pool + entry.offset, entry.accession_length, accession_table);
+                indexes.emplace_back(accession, std::string(pool + entry.offset, entry.version_length), entry.pos, entry.length);
+                accession2taxid.emplace(accession, taxid);
+            }
+        }
+        covered = std::max(covered, range.second);
+    }
+
+    // keep the order of the sequences file, accessions of one record by name
+    std::sort(indexes.begin(), indexes.end(), [](const Index& a, const Index& b) {
+        return (a.pos < b.pos) || ((a.pos == b.pos) && (a.accession_version < b.accession_version));
+    });
+}
+
+Accession::Accession() : key_(UINT64_MAX) {}
+
+Accession::Accession(const char* accession) : Accession(std::string(accession)) {}
+
+Accession::Accession(const std::string& accession) {
+    if (! pack(accession.data(), accession.size(), key_)) {
+        throw std::runtime_error(accession + ": Accession does not pack, an AccessionTable is needed");
+    }
+}
+
+Accession::Accession(const char* data, std::size_t size, AccessionTable& table) {
+    if (pack(data, size, key_)) {
+        return;
+    }
+    const std::string& name = *table.names_.emplace(data, size).first;
+    key_ = SIDE_ACCESSION | reinterpret_cast<std::uintptr_t>(&name);
+}
+
+Accession::Accession(const std::string& accession, AccessionTable& table) : Accession(accession.data(), accession.size(), table) {}
+
+bool Accession::pack(const char* data, std::size_t size, Accession& accession) {
+    return pack(data, size, accession.key_);
+}
+
+bool Accession::pack(const char* data, std::size_t size, std::uint64_t& key) {
+    std::size_t letters = 0;
+    while ((letters < size) && (data[letters] >= 'A') && (data[letters] <= 'Z')) {
+        ++letters;
+    }
+    bool underscore = (letters < size) && (data[letters] == '_');
+    std::size_t begin = letters + (underscore ? 1 : 0);
+    std::size_t digits = size - begin;
+    for (std::size_t format=0; format<ACCESSION_FORMATS.size(); ++format) {
+        const AccessionFormat& f = ACCESSION_FORMATS[format];
+        if ((f.letters != letters) || (f.underscore != underscore) || (f.digits != digits)) continue;
+        std::uint64_t payload = 0;
+        for (std::size_t i=0; i<letters; ++i) {
+            payload = payload * 26 + (data[i] - 'A');
+        }
+        for (std::size_t i=begin; i<size; ++i) {
+            if ((data[i] < '0') || (data[i] > '9')) return false;
+            payload = payload * 10 + (data[i] - '0');
+        }
+        key = (static_cast<std::uint64_t>(format) << ACCESSION_PAYLOAD_BITS) | payload;
+        return true;
+    }
+    return false;
+}
+
+std::string Accession::str() const {
+    if (key_ == UINT64_MAX) {
+        return "";
+    }
+    if (! packed()) {
+        return *reinterpret_cast<const std::string*>(static_cast<std::uintptr_t>(key_ & ~SIDE_ACCESSION));
+    }
+    const AccessionFormat& f = ACCESSION_FORMATS[key_ >> ACCESSION_PAYLOAD_BITS];
+    std::uint64_t payload = key_ & ((std::uint64_t(1) << ACCESSION_PAYLOAD_BITS) - 1);
+    std::string accession(f.letters + (f.underscore ? 1 : 0) + f.digits, '0');
+    for (std::size_t i=accession.size(); i>accession.size()-f.digits; --i) {
+        accession[i-1] = '0' + payload % 10;
+        payload /= 10;
+    }
+    if (f.underscore) {
+        accession[f.letters] = '_';
+    }
+    for (std::size_t i=f.letters; i>0; --i) {
+        accession[i-1] = 'A' + payload % 26;
+        payload /= 26;
+    }
+    return accession;
+}
+
+std::uint64_t Accession::key() const {
+    return key_;
+}
+
+bool Accession::packed() const {
+    return (key_ & SIDE_ACCESSION) == 0;
+}
+
+bool Accession::operator==(const Accession& other) const {
+    return key_ == other.key_;
+}
+
+bool Accession::operator!=(const Accession& other) const {
+    return key_ != other.key_;
+}
+
+AccessionTable::AccessionTable() {}
+
+std::size_t AccessionTable::size() const {
+    return names_.size();
+}
+
+Index::Index() : pos(0) , length(0) {
+}
+
+Index::Index(Accession accession, std::string accession_version, std::size_t pos, std::size_t length)
+    : accession(accession)
+    , accession_version(std::move(accession_version))
+    , pos(pos)
+    , length(length) {
+}
+
+void IndexIO::create(const std::string& infile, const std::string& outfile, unsigned int threads) {
+    std::ofstream out(outfile);
+    if (! out) {
+        throw std::runtime_error(outfile + ": Failed to open file");
+    }
+    if (os::path::is_gzip(infile)) {
+        scan_gzip_fasta(infile, [&](const str::View& line, std::uint64_t pos, std::uint64_t length) {
+            for_each_header_accession(line, [&](const char* version, std::size_t accession_length, std::size_t version_length) {
+                out.write(version, accession_length) << '\t';
+                out.write(version, version_length) << '\t';
+                out << pos << '\t' << length << '\n';
+            });
+        });
+        out.close();
+        index_bgzf(infile);
+        return;
+    }
+    os::MappedFile in(infile);
+    std::vector<std::vector<Header>> chunks;
+    scan_fasta(in, infile, threads, chunks);
+    const char* data = in.data();
+    for_each_record(chunks, in.size(), [&](const Header& header, std::size_t length) {
+        for_each_header_accession(header_line(data, in.size(), header.pos), [&](const char* version,
+                                  std::size_t accession_length, std::size_t version_length) {
+            out.write(version, accession_length) << '\t';
+            out.write(version, version_length) << '\t';
+            out << header.pos << '\t' << length << '\n';
+        });
+    });
+    out.close();
+}
+
+void IndexIO::parse(
+    const std::string& file,
+    const std::unordered_set<Accession>& accessions,
+    std::vector<Index>& indexes
+) {
     std::ifstream in(file);
     if (! in) {
-        throw std::runtime_error(file + ": Failed to open file");
+        throw std::runtime_error(file + ": Failed to open file");
+    }
+    std::string line;
+    AccessionMatcher matcher(accessions);
+    Accession accession;
+    std::uint64_t pos = 0;
+    std::uint64_t length = 0;
+    str::Fields<4> row("\t");
+    while (std::getline(in, line)) {
+        if (! row.split(line)) {
+            continue;
+        }
+        if (matcher.find(row[0].data, row[0].size, accession)) {
+            if ((! str::to_uint(row[2], pos)) || (! str::to_uint(row[3], length))) {
+                throw std::runtime_error(file + ": Invalid index file");
+            }
+            indexes.emplace_back(accession, row[1].str(), pos, length);
+        }
+    }
+    in.close();
+}
+
+void BinaryIndexIO::create(const std::string& infile, const std::string& outfile, unsigned int threads) {
+    FileStamp source;
+    source.assign(infile);
+    if (os::path::is_gzip(infile)) {
+        IndexWriter writer;
+        scan_gzip_fasta(infile, [&](const str::View& line, std::uint64_t pos, std::uint64_t length) {
+            writer.add(line, pos, length);
+        });
+        writer.write(outfile, source);
+        index_bgzf(infile);
+        return;
+    }
+    os::MappedFile in(infile);
+    std::vector<std::vector<Header>> chunks;
+    scan_fasta(in, infile, threads, chunks);
+    const char* data = in.data();
+    IndexWriter writer;
+    for_each_record(chunks, in.size(), [&](const Header& header, std::size_t length) {
+        writer.add(header_line(data, in.size(), header.pos), header.pos, length);
+    });
+    writer.write(outfile, source);
+}
+
+BinaryIndexIO::Status BinaryIndexIO::check(const std::string& infile, const std::string& file) {
+    if (! os::path::exists(file)) {
+        return STALE;
+    }
+    FileStamp source;
+    try {
+        source = IndexReader(file).source;
+    } catch (const std::exception&) {
+        return STALE;  // older or damaged index
+    }
+    if (source.matches(infile)) {
+        return CURRENT;
+    }
+    // gzip offsets cannot be resumed, so only plain files are extended
+    if ((! os::path::is_gzip(infile)) && source.prefix_of(infile)) {
+        return APPENDED;
+    }
+    return STALE;
+}
+
+void BinaryIndexIO::append(const std::string& infile, const std::string& file, unsigned int threads) {
+    FileStamp source;
+    source.assign(infile);
+    IndexReader index(file);
+    if (index.nrecords == 0) {
+        create(infile, file, threads);
+        return;
+    }
+    // the last record may have grown with the appended bytes, so it is scanned again with the tail
+    std::size_t kept = index.nrecords - 1;
+    os::MappedFile in(infile);
+    std::vector<std::vector<Header>> chunks;
+    scan_fasta(in, infile, threads, chunks, index.records[kept].pos);
+    const char* data = in.data();
+    IndexWriter writer;
+    writer.append(index, kept);
+    for_each_record(chunks, in.size(), [&](const Header& header, std::size_t length) {
+        writer.add(header_line(data, in.size(), header.pos), header.pos, length);
+    });
+    writer.write(file, source);
+}
+
+void BinaryIndexIO::convert(const std::string& infile, const std::string& outfile, const std::string& source_file) {
+    std::ifstream in(infile);
+    if (! in) {
+        throw std::runtime_error(infile + ": Failed to open file");
     }
+    IndexWriter writer;
     std::string line;
-    std::vector<std::string> row;
+    std::uint64_t pos = 0;
+    std::uint64_t length = 0;
+    std::uint64_t last_pos = UINT64_MAX;
+    std::uint64_t last_length = 0;
+    str::Fields<4> row("\t");
     while (std::getline(in, line)) {
-        str::split(line, "\t|\t", row);
-        if ((row.size() == 4) && is_scientific_name(row[3])) {
-            names.emplace(row[0], row[1]);
+        if ((! row.split(line)) || (! str::to_uint(row[2], pos)) || (! str::to_uint(row[3], length))) {
+            throw std::runtime_error(infile + ": Invalid index file");
+        }
+        // consecutive lines of one record are the accessions of a multi-accession header
+        if ((pos == last_pos) && (length == last_length)) {
+            writer.alias(row[1].data, row[0].size, row[1].size);
+        } else {
+            writer.add(row[1].data, row[0].size, row[1].size, pos, length);
         }
-        row.clear();
+        last_pos = pos;
+        last_length = length;
     }
     in.close();
+    FileStamp source;
+    source.assign(source_file);
+    writer.write(outfile, source);
 }
 
-bool NameIO::is_scientific_name(const std::string& name) {
-    return name.rfind("scientific name", 0) == 0;
+void BinaryIndexIO::dump(const std::string& file, const std::string& outfile) {
+    IndexReader index(file);
+    std::ofstream out(outfile);
+    if (! out) {
+        throw std::runtime_error(outfile + ": Failed to open file");
+    }
+    std::vector<const IndexKey*> keys(index.nkeys);
+    for (std::size_t i=0; i<index.nkeys; ++i) {
+        keys[i] = index.keys + i;
+    }
+    // in file order, the accessions of a record as in its header
+    std::sort(keys.begin(), keys.end(), [](const IndexKey* a, const IndexKey* b) {
+        return (a->record < b->record) || ((a->record == b->record) && (a->offset < b->offset));
+    });
+    for (const IndexKey* key : keys) {
+        const IndexRecord& record = index.records[key->record];
+        out.write(index.pool + key->offset, key->accession_length) << '\t';
+        out.write(index.pool + key->offset, key->version_length) << '\t';
+        out << record.pos << '\t' << record.length << '\n';
+    }
+    out.close();
 }
 
-Node::Node() : parent(nullptr) {}
+void BinaryIndexIO::parse(
+    const std::string& file,
+    const std::unordered_set<Accession>& accessions,
+    std::vector<Index>& indexes
+) {
+    IndexReader index(file);
 
-Node::Node(std::string id, std::string name)
-    : id(std::move(id))
-    , name(std::move(name))
-    , parent(nullptr) {}
+    const char* pool = index.pool;
+    if (accessions.size() >= index.nkeys / 16) {
+        // many queries, probing every key is cheaper than decoding and sorting them
+        AccessionMatcher matcher(accessions);
+        Accession accession;
+        for (std::size_t i=0; i<index.nkeys; ++i) {
+            const IndexKey& key = index.keys[i];
+            if (matcher.find(pool + key.offset, key.accession_length, accession)) {
+                const IndexRecord& record = index.records[key.record];
+                indexes.emplace_back(accession, std::string(pool + key.offset, key.version_length), record.pos, record.length);
+            }
+        }
+    } else {
+        // look up sorted accessions, each search resumes where the previous one stopped
+        std::vector<std::pair<std::string, Accession>> queries;
+        queries.reserve(accessions.size());
+        for (const Accession& accession : accessions) {
+            queries.emplace_back(accession.str(), accession);
+        }
+        std::sort(queries.begin(), queries.end(), [](const std::pair<std::string, Accession>& a,
+                                                     const std::pair<std::string, Accession>& b) {
+            return a.first < b.first;
+        });
+        const IndexKey* it = index.keys;
+        const IndexKey* end = index.keys + index.nkeys;
+        for (const std::pair<std::string, Accession>& query : queries) {
+            const std::string& value = query.first;
+            it = std::lower_bound(it, end, value, [pool](const IndexKey& key, const std::string& value) {
+                return compare_key(pool, key, value.data(), value.length()) < 0;
+            });
+            for (; (it != end) && (compare_key(pool, *it, value.data(), value.length()) == 0); ++it) {
+                const IndexRecord& record = index.records[it->record];
+                indexes.emplace_back(query.second, std::string(pool + it->offset, it->version_length), record.pos, record.length);
+            }
+        }
+    }
 
-Node::Node(std::string id, std::string name, Node* parent, std::string rank)
-    : id(std::move(id))
-    , name(std::move(name))
-    , parent(parent)
-    , rank(std::move(rank)) {
+    // keep the order of the sequences file, accessions of one record by name
+    std::sort(indexes.begin(), indexes.end(), [](const Index& a, const Index& b) {
+        return (a.pos < b.pos) || ((a.pos == b.pos) && (a.accession_version < b.accession_version));
+    });
 }
 
-bool Node::is_root() const {
-    return parent == nullptr;
+HeaderFilter::HeaderFilter(const std::string& spec) : exclude_(false), is_regex_(false) {
+    std::string pattern = spec;
+    if ((! pattern.empty()) && (pattern[0] == '!')) {
+        exclude_ = true;
+        pattern.erase(0, 1);
+    }
+    if ((pattern.size() >= 2) && (pattern.front() == '/') && (pattern.back() == '/')) {
+        is_regex_ = true;
+        pattern = pattern.substr(1, pattern.size() - 2);
+        try {
+            regex_.assign(pattern, std::regex::ECMAScript | std::regex::optimize);
+        } catch (const std::regex_error&) {
+            throw std::runtime_error(spec + ": Invalid regular expression");
+        }
+    }
+    text_ = pattern;
 }
 
-void Node::append(Node* child) {
-    children.push_back(child);
+bool HeaderFilter::empty() const {
+    return text_.empty() && (! is_regex_);
 }
 
-void Node::trace(std::vector<const Node*>& ancestors) const {
-    ancestors.push_back(this);
-    if (is_root()) return;
-    parent->trace(ancestors);
+bool HeaderFilter::keeps(const char* description, std::size_t size) const {
+    const char* end = description + size;
+    bool found = is_regex_
+        ? std::regex_search(description, end, regex_)
+        : text_.empty() || (std::search(description, end, text_.begin(), text_.end()) != end);
+    return found != exclude_;
 }
 
-void Node::expand(std::vector<const Node*>& descendants) const {
-    descendants.push_back(this);
-    if (children.empty()) return;
-    for (const Node* child : children) {
-        child->expand(descendants);
+void DescriptionIO::create(const std::string& infile, const std::string& outfile, unsigned int threads) {
+    FileStamp source;
+    source.assign(infile);
+    DescriptionWriter writer(outfile);
+    if (os::path::is_gzip(infile)) {
+        bool first = true;
+        std::vector<Header> headers;
+        for_each_gzip_chunk(infile, [&](const char* data, std::size_t n, std::uint64_t offset) {
+            if (first && ((n < 3) || (data[0] != '>'))) {
+                throw std::runtime_error(infile + ": Invalid fasta file");
+            }
+            first = false;
+            headers.clear();
+            scan_headers(data, n, 0, n, headers);
+            for (const Header& header : headers) {
+                writer.add(offset + header.pos, parse_description(data, n, header));
+            }
+        });
+        if (first) {
+            throw std::runtime_error(infile + ": Invalid fasta file");
+        }
+    } else {
+        os::MappedFile in(infile);
+        std::vector<std::vector<Header>> chunks;
+        scan_fasta(in, infile, threads, chunks);
+        for (const std::vector<Header>& chunk : chunks) {
+            for (const Header& header : chunk) {
+                writer.add(header.pos, parse_description(in.data(), in.size(), header));
+            }
+        }
     }
+    writer.write(source);
 }
 
-bool Node::is_principal() const {
-    return PRINCIPALS.find(rank) != PRINCIPALS.end();
-}
-
-std::string Node::str(bool abbr) const {
-    std::string str;
-    if (abbr && is_principal()) {
-        str = rank[0] + RANK_DELIMITER + name;
-    } else {
-        str = rank + RANK_DELIMITER + name;
+bool DescriptionIO::filter(
+    const std::string& file,
+    const std::string& source_file,
+    const HeaderFilter& filter,
+    std::vector<Index>& indexes
+) {
+    if (! os::path::exists(file)) {
+        return false;
     }
-    str::replace(str, " ", "_");
-    return str;
-}
+    os::MappedFile in(file);
+    const DescriptionHeader* header = reinterpret_cast<const DescriptionHeader*>(in.data());
+    if ((in.size() < sizeof(DescriptionHeader))
+        || (memcmp(header->magic, DESCRIPTION_MAGIC, sizeof(header->magic)) != 0)
+        || (header->version != DESCRIPTION_VERSION)
+        || (in.size() != sizeof(DescriptionHeader) + header->pool_size + (header->records + 1) * sizeof(DescriptionEntry))
+        || (! header->source.matches(source_file))) {
+        return false;
+    }
+    const char* pool = in.data() + sizeof(DescriptionHeader);
+    const DescriptionEntry* entries = reinterpret_cast<const DescriptionEntry*>(pool + header->pool_size);
+    const DescriptionEntry* end = entries + header->records;
 
-std::string Node::lineage(bool principal) const {
-    std::vector<const Node*> ancestors;
-    trace(ancestors);
-    std::string lineage;
-    for (const Node* node : ancestors) {
-        if (principal && (! node->is_principal())) {
-            continue;
+    // indexes are in file order, each search resumes where the previous one stopped;
+    // a record missing from the store has an empty description
+    const DescriptionEntry* it = entries;
+    std::size_t kept = 0;
+    for (std::size_t i=0; i<indexes.size(); ++i) {
+        if ((it == end) || (it->pos > indexes[i].pos)) {
+            it = entries;
         }
-        
-        if (lineage.empty()) {
-            lineage = node->str(principal);
-        } else {
-            lineage = node->str(principal) + "; " + lineage;
+        it = std::lower_bound(it, end, indexes[i].pos, [](const DescriptionEntry& entry, std::uint64_t pos) {
+            return entry.pos < pos;
+        });
+        bool found = (it != end) && (it->pos == indexes[i].pos);
+        const char* description = found ? pool + it->offset : pool;
+        std::size_t size = found ? (it + 1)->offset - it->offset : 0;
+        if (filter.keeps(description, size)) {
+            if (kept != i) {
+                indexes[kept] = std::move(indexes[i]);
+            }
+            ++kept;
         }
     }
-    return lineage;
+    indexes.resize(kept);
+    return true;
 }
 
-void NodeIO::parse(
-    const std::string& file,
-    const std::unordered_map<std::string, std::string>& names,
-    std::unordered_map<std::string, Node*>& nodes
-) {
+Target::Target() {}
+
+Target::Target(std::string id, std::string taxa_file, std::string seqs_file)
+    : id(std::move(id))
+    , taxa_file(std::move(taxa_file))
+    , seqs_file(std::move(seqs_file)) {
+}
+
+void TargetIO::parse(const std::string& file, std::vector<Target>& targets) {
     std::ifstream in(file);
     if (! in) {
         throw std::runtime_error(file + ": Failed to open file");
     }
     std::string line;
-    std::vector<std::string> row;
+    str::Fields<3> row("\t");
+    str::Fields<2> short_row("\t");  // without a sequences file
     while (std::getline(in, line)) {
-        str::split(line, "\t|\t", row);
-        if (row.size() != 13) {  // omit malformed line
-            row.clear();
+        if (line.empty() || (line[0] == '#')) {
             continue;
         }
-
-        // get or create parent node
-        Node* parent = nullptr;
-        if (row[0] != "1") {  // nullptr if is root
-            if (nodes.find(row[1]) != nodes.end()) {  // get if already exists
-                parent = nodes.at(row[1]);
-            } else {  // create if not exist
-                parent = new Node(row[1], names.at(row[1]));
-                nodes.emplace(row[1], parent);
-            }
+        if (row.split(line) && (row[0].size > 0) && (row[1].size > 0)) {
+            targets.emplace_back(row[0].str(), row[1].str(), row[2].str());
+        } else if (short_row.split(line) && (short_row[0].size > 0) && (short_row[1].size > 0)) {
+            targets.emplace_back(short_row[0].str(), short_row[1].str(), "");
+        } else {
+            throw std::runtime_error(file + ": Invalid batch file (expected taxon ID, taxa file and optional sequences file)");
         }
+    }
+    in.close();
+}
 
-        // create or update node
-        Node* node = nullptr;
-        if (nodes.find(row[0]) != nodes.end()) {  // update if already exists
-            node = nodes.at(row[0]);
-            node->parent = parent;
-            node->rank = row[2];
-        } else {  // create if not exist
-            node = new Node(row[0], names.at(row[0]), parent, row[2]);
-            nodes.emplace(row[0], node);
+void ResultIO::select(
+    const std::vector<Index>& indexes,
+    const std::unordered_map<Accession, std::uint32_t>& accession2taxid,
+    const Taxonomy& taxonomy,
+    const Node& node,
+    std::vector<std::size_t>& selection
+) {
+    for (std::size_t i=0; i<indexes.size(); ++i) {
+        if (node.contains(taxonomy.find(accession2taxid.at(indexes[i].accession)))) {
+            selection.push_back(i);
         }
+    }
+}
+
+void ResultIO::write_taxa(
+    const std::vector<Index>& indexes,
+    const std::unordered_map<Accession, std::uint32_t>& accession2taxid,
+    const Taxonomy& taxonomy,
+    bool full_lineage,
+    const std::string& outfile
+) {
+    std::vector<std::size_t> selection(indexes.size());
+    for (std::size_t i=0; i<indexes.size(); ++i) {
+        selection[i] = i;
+    }
+    write_taxa(indexes, selection, accession2taxid, taxonomy, full_lineage, outfile);
+}
+
+void ResultIO::write_taxa(
+    const std::vector<Index>& indexes,
+    const std::vector<std::size_t>& selection,
+    const std::unordered_map<Accession, std::uint32_t>& accession2taxid,
+    const Taxonomy& taxonomy,
+    bool full_lineage,
+    const std::string& outfile
+) {
+    write_taxa(indexes, selection, std::vector<std::size_t>(), accession2taxid, taxonomy, full_lineage, outfile);
+}
 
-        // append node to parent's children
-        if (parent != nullptr) {
-            parent->append(node);
+void ResultIO::write_taxa(
+    const std::vector<Index>& indexes,
+    const std::vector<std::size_t>& selection,
+    const std::vector<std::size_t>& representatives,
+    const std::unordered_map<Accession, std::uint32_t>& accession2taxid,
+    const Taxonomy& taxonomy,
+    bool full_lineage,
+    const std::string& outfile
+) {
+    std::ofstream out(outfile);
+    if (! out) {
+        throw std::runtime_error(outfile + ": Failed to open file");
+    }
+    bool principal = ! full_lineage;
+    std::unordered_map<std::uint32_t, std::string> lineages;  // many sequences share a taxon
+    std::string buffer;
+    for (std::size_t j=0; j<selection.size(); ++j) {
+        const Index& index = indexes[selection[j]];
+        std::uint32_t taxid = accession2taxid.at(index.accession);
+        auto it = lineages.find(taxid);
+        if (it == lineages.end()) {
+            Node node = taxonomy.find(taxid);
+            if (! node.valid()) {
+                throw std::runtime_error(std::to_string(taxid) + ": Taxon ID not found");
+            }
+            it = lineages.emplace(taxid, node.lineage(principal)).first;
+        }
+        buffer += index.accession_version;
+        buffer += '\t';
+        buffer += it->second;
+        if (! representatives.empty()) {
+            buffer += '\t';
+            buffer += indexes[representatives[j]].accession_version;
+        }
+        buffer += '\n';
+        if (buffer.size() >= WRITE_BUFFER_SIZE) {
+            out.write(buffer.data(), buffer.size());
+            buffer.clear();
         }
-        row.clear();
     }
+    out.write(buffer.data(), buffer.size());
+    out.close();
 }
 
-void NodeIO::destroy(std::unordered_map<std::string, Node*>& nodes) {
-    for (auto it=nodes.begin(); it!=nodes.end(); ++it) {
-        delete it->second;
-        it->second = nullptr;
+void ResultIO::write_seqs(
+    const std::string& infile,
+    const std::vector<Index>& indexes,
+    const std::string& outfile,
+    unsigned int threads
+) {
+    std::vector<std::vector<std::size_t>> selections(1, std::vector<std::size_t>(indexes.size()));
+    for (std::size_t i=0; i<indexes.size(); ++i) {
+        selections[0][i] = i;
     }
+    write_seqs(infile, indexes, selections, std::vector<std::string>(1, outfile), threads);
 }
 
-void Accession2TaxIdIO::parse(
-    const std::string& file,
-    const std::unordered_set<std::string>& taxids,
-    std::unordered_map<std::string, std::string>& accession2taxid
+void ResultIO::write_seqs(
+    const std::string& infile,
+    const std::vector<Index>& indexes,
+    const std::vector<std::vector<std::size_t>>& selections,
+    const std::vector<std::string>& outfiles,
+    unsigned int threads
 ) {
-    std::ifstream in(file);
-    if (! in) {
-        throw std::runtime_error(file + ": Failed to open file");
+    std::vector<os::File> outs;
+    for (const std::string& outfile : outfiles) {
+        outs.emplace_back(outfile, os::File::WRITE);
     }
+    std::vector<Run> runs;
+    collect_runs(indexes, selections, runs);
+    write_runs(infile, runs, outs, threads);
+    for (os::File& out : outs) {
+        out.close();
+    }
+}
 
-    // omit header
-    std::string line;
-    if (! std::getline(in, line)) {
-        return;
+void ResultIO::write_seqs(
+    const std::string& infile,
+    const std::vector<Index>& indexes,
+    const std::vector<std::vector<std::size_t>>& selections,
+    const std::vector<std::string>& outfiles,
+    std::vector<std::vector<std::size_t>>& representatives,
+    unsigned int threads
+) {
+    std::vector<os::File> outs;
+    for (const std::string& outfile : outfiles) {
+        outs.emplace_back(outfile, os::File::WRITE);
     }
 
-    std::vector<std::string> row;
-    while (std::getline(in, line)) {
-        str::split(line, '\t', row);
-        if ((row.size() == 4) && (taxids.find(row[2]) != taxids.end())) {
-            accession2taxid.emplace(row[0], row[2]);
+    // every selected record in file order, a record selected for several outputs is read once
+    struct Slot {
+        std::size_t index;
+        std::uint32_t output;
+        std::size_t rank;  // in the selection of the output
+    };
+    std::vector<Slot> slots;
+    representatives.assign(selections.size(), std::vector<std::size_t>());
+    for (std::size_t k=0; k<selections.size(); ++k) {
+        representatives[k].resize(selections[k].size());
+        for (std::size_t j=0; j<selections[k].size(); ++j) {
+            slots.push_back(Slot{selections[k][j], static_cast<std::uint32_t>(k), j});
         }
-        row.clear();
     }
-    in.close();
+    std::stable_sort(slots.begin(), slots.end(), [&indexes](const Slot& a, const Slot& b) {
+        return indexes[a.index].pos < indexes[b.index].pos;
+    });
+
+    // distinct records, as ranges [starts[g], starts[g+1]) of slots
+    std::vector<std::size_t> starts;
+    for (std::size_t i=0; i<slots.size(); ++i) {
+        const Index& index = indexes[slots[i].index];
+        if ((i == 0) || (indexes[slots[i-1].index].pos != index.pos) || (indexes[slots[i-1].index].length != index.length)) {
+            starts.push_back(i);
+        }
+    }
+    starts.push_back(slots.size());
+
+    // each record is read once, in file order, and written right after it is hashed to the outputs it is new to
+    std::vector<std::unordered_map<Fingerprint::Digest, std::size_t, DigestHash>> written(outs.size());
+    auto place = [&](std::size_t g, const Fingerprint::Digest& digest, const std::function<void(os::File&)>& write) {
+        for (std::size_t i=starts[g]; i<starts[g+1]; ++i) {
+            const Slot& slot = slots[i];
+            auto it = written[slot.output].emplace(digest, slot.index);
+            if (it.second) {
+                write(outs[slot.output]);
+            }
+            representatives[slot.output][slot.rank] = it.first->second;
+        }
+    };
+    if (! os::path::is_gzip(infile)) {
+        // a batch of records is hashed on all threads, then written from the mapping while its pages are cached
+        os::MappedFile in(infile);
+        std::vector<Fingerprint::Digest> digests;
+        for (std::size_t g=0; g+1<starts.size(); ) {
+            std::size_t h = g;
+            std::uint64_t bytes = 0;
+            while ((h + 1 < starts.size()) && ((h == g) || (bytes < HASH_BATCH_SIZE))) {
+                const Index& index = indexes[slots[starts[h]].index];
+                if (index.pos + index.length > in.size()) {
+                    throw std::runtime_error(infile + ": Failed to read record at " + std::to_string(index.pos));
+                }
+                bytes += index.length;
+                ++h;
+            }
+            digests.resize(h - g);
+            std::size_t n = std::max<std::size_t>(1, std::min<std::size_t>(threads, h - g));
+            run_parallel(n, [&](std::size_t t) {
+                for (std::size_t k=g+t; k<h; k+=n) {
+                    const Index& index = indexes[slots[starts[k]].index];
+                    Fingerprint fingerprint;
+                    fingerprint.update(in.data() + index.pos, index.length);
+                    digests[k - g] = fingerprint.digest();
+                }
+            });
+            for (std::size_t k=g; k<h; ++k) {
+                const Index& index = indexes[slots[starts[k]].index];
+                place(k, digests[k - g], [&](os::File& out) {
+                    out.write(in.data() + index.pos, index.length);
+                });
+            }
+            g = h;
+        }
+    } else {
+        // inflated once, so the bytes are held while they are hashed
+        RecordReader in(infile);
+        HeldRecord held(outfiles[0] + "." + str::random(8));
+        for (std::size_t g=0; g+1<starts.size(); ++g) {
+            const Index& index = indexes[slots[starts[g]].index];
+            Fingerprint fingerprint;
+            held.clear();
+            in.read(index.pos, index.length, [&](const char* data, std::size_t n) {
+                fingerprint.update(data, n);
+                held.append(data, n);
+            });
+            place(g, fingerprint.digest(), [&](os::File& out) {
+                held.write(out);
+            });
+        }
+    }
+    for (os::File& out : outs) {
+        out.close();
+    }
 }
 
-Index::Index() : pos(0) , length(0) {
+
+Metrics::Metrics()
+    : created_(std::chrono::steady_clock::now())
+    , started_(created_)
+    , io_read_bytes_(0)
+    , io_write_bytes_(0) {
 }
 
-Index::Index(std::string accession, std::string accession_version, std::size_t pos, std::size_t length)
-    : accession(std::move(accession))
-    , accession_version(std::move(accession_version))
-    , pos(pos)
-    , length(length) {
+void Metrics::start(const std::string& name) {
+    Stage stage;
+    stage.name = name;
+    stages_.push_back(stage);
+    os::reset_peak_rss();
+    io_read_bytes_ = os::io_read_bytes();
+    io_write_bytes_ = os::io_write_bytes();
+    started_ = std::chrono::steady_clock::now();
 }
 
-void IndexIO::create(const std::string& infile, const std::string& outfile) {
-    std::ifstream in(infile);
-    std::ofstream out(outfile);
-    if (! in) {
-        throw std::runtime_error(infile + ": Failed to open file");
+void Metrics::stop(
+    const std::vector<std::string>& inputs,
+    const std::vector<std::string>& outputs,
+    std::int64_t records_scanned,
+    std::int64_t records_matched
+) {
+    Stage& stage = stages_.back();
+    stage.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started_).count();
+    stage.peak_rss = os::peak_rss();
+    stage.io_read_bytes = os::io_read_bytes() - io_read_bytes_;
+    stage.io_write_bytes = os::io_write_bytes() - io_write_bytes_;
+    stage.input_bytes = 0;
+    for (const std::string& input : inputs) {
+        stage.input_bytes += os::path::exists(input) ? os::path::size(input) : 0;
+    }
+    stage.output_bytes = 0;
+    for (const std::string& output : outputs) {
+        stage.output_bytes += os::path::exists(output) ? os::path::size(output) : 0;
+    }
+    stage.records_scanned = records_scanned;
+    stage.records_matched = records_matched;
+}
+
+void Metrics::cancel() {
+    stages_.pop_back();
+}
+
+double Metrics::elapsed() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - created_).count();
+}
+
+const std::vector<Metrics::Stage>& Metrics::stages() const {
+    return stages_;
+}
+
+namespace {
+    std::string json_string(const std::string& value) {
+        std::string quoted = "\"";
+        for (char c : value) {
+            if ((c == '"') || (c == '\\')) {
+                quoted += '\\';
+                quoted += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                quoted += escaped;
+            } else {
+                quoted += c;
+            }
+        }
+        return quoted + "\"";
     }
+
+    std::string json_number(double value) {
+        char number[32];
+        snprintf(number, sizeof(number), "%.6f", value);
+        return number;
+    }
+
+    std::string json_count(std::int64_t value) {
+        return (value < 0) ? "null" : std::to_string(value);
+    }
+}
+
+void MetricsIO::write(const std::string& file, const Metrics& metrics, const std::string& command, unsigned int threads) {
+    std::ofstream out(file);
     if (! out) {
-        throw std::runtime_error(outfile + ": Failed to open file");
+        throw std::runtime_error(file + ": Failed to open file");
     }
+    out << "{\n"
+        << "  \"command\": " << json_string(command) << ",\n"
+        << "  \"threads\": " << threads << ",\n"
+        << "  \"seconds\": " << json_number(metrics.elapsed()) << ",\n"
+        << "  \"stages\": [";
+    const std::vector<Metrics::Stage>& stages = metrics.stages();
+    for (std::size_t i=0; i<stages.size(); ++i) {
+        const Metrics::Stage& stage = stages[i];
+        // throughput over the larger side, lookups read little of their inputs but may write a lot
+        std::uint64_t bytes = std::max(stage.input_bytes, stage.output_bytes);
+        out << ((i == 0) ? "\n" : ",\n")
+            << "    {\"name\": " << json_string(stage.name)
+            << ", \"seconds\": " << json_number(stage.seconds)
+            << ", \"input_bytes\": " << stage.input_bytes
+            << ", \"output_bytes\": " << stage.output_bytes
+            << ", \"io_read_bytes\": " << stage.io_read_bytes
+            << ", \"io_write_bytes\": " << stage.io_write_bytes
+            << ", \"records_scanned\": " << json_count(stage.records_scanned)
+            << ", \"records_matched\": " << json_count(stage.records_matched)
+            << ", \"throughput_mb_per_s\": " << json_number((stage.seconds > 0) ? bytes / stage.seconds / (1 << 20) : 0.0)
+            << ", \"peak_rss_bytes\": " << stage.peak_rss << "}";
+    }
+    out << (stages.empty() ? "]\n" : "\n  ]\n") << "}\n";
+    out.close();
+    if (! out) {
+        throw std::runtime_error(file + ": Failed to write file");
+    }
+}
 
-    std::streampos begin = 0;
-    std::string line;
-    std::getline(in, line);
-    if ((line.length() < 3) || line[0] != '>') {
-        throw std::runtime_error(infile + ": Invalid fasta file");
+Request::Request() : full_lineage(false), dedup(false), threads(1) {}
+
+Request::Request(std::string id, std::string taxa_file, std::string seqs_file, bool full_lineage)
+    : id(std::move(id))
+    , taxa_file(std::move(taxa_file))
+    , seqs_file(std::move(seqs_file))
+    , full_lineage(full_lineage)
+    , dedup(false)
+    , threads(1) {
+}
+
+std::string RequestIO::format(const Request& request) {
+    return request.id + "\t" + request.taxa_file + "\t" + request.seqs_file
+        + "\t" + (request.full_lineage ? "1" : "0") + "\t" + (request.dedup ? "1" : "0")
+        + "\t" + std::to_string(request.threads) + "\t" + request.header_filter + "\n";
+}
+
+bool RequestIO::parse(const std::string& line, Request& request) {
+    str::Fields<7> row("\t");
+    std::uint64_t threads = 0;
+    if ((! row.split(line)) || (row[0].size == 0) || (row[1].size == 0)
+        || ((row[3] != "0") && (row[3] != "1")) || ((row[4] != "0") && (row[4] != "1"))
+        || (! str::to_uint(row[5], threads)) || (threads == 0) || (threads > UINT32_MAX)) {
+        return false;
     }
+    request = Request(row[0].str(), row[1].str(), row[2].str(), row[3] == "1");
+    request.dedup = row[4] == "1";
+    request.threads = threads;
+    request.header_filter = row[6].str();
+    return true;
+}
 
-    std::size_t dot_pos = line.find('.');
-    std::string accession = line.substr(1, dot_pos-1);
-    std::size_t space_pos = line.find(' ', dot_pos+1);
-    std::string accession_version = line.substr(1, space_pos-1);
-    std::streampos end = in.tellg();
-    while (std::getline(in, line)) {
-        if (line[0] == '>') {
-            out << accession << '\t' << accession_version << '\t' << begin << '\t' << (end - begin) << '\n';
-            dot_pos = line.find('.');
-            accession = line.substr(1, dot_pos-1);
-            space_pos = line.find(' ', dot_pos+1);
-            accession_version = line.substr(1, space_pos-1);
-            begin = end;
+Server::Server(const Taxonomy& taxonomy, const Database& database, std::string infile, unsigned int threads)
+    : taxonomy_(taxonomy)
+    , database_(database)
+    , infile_(std::move(infile))
+    , threads_(std::max(1u, threads))
+    , stopped_(false)
+    , idle_threads_(threads_) {
+}
+
+Server::~Server() {
+    if (! socket_file_.empty()) {
+        unlink(socket_file_.c_str());
+    }
+}
+
+void Server::listen(const std::string& socket_file) {
+    listener_ = os::Socket::listen(socket_file);
+    socket_file_ = socket_file;
+}
+
+void Server::serve() {
+    std::deque<os::Socket> connections;
+    std::vector<const os::Socket*> answering;  // shut down on stopping, idle clients would block the workers
+    bool closing = false;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::vector<std::thread> workers;
+    for (unsigned int i=0; i<threads_; ++i) {
+        workers.emplace_back([&]() {
+            while (true) {
+                os::Socket connection;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    ready.wait(lock, [&]() { return closing || (! connections.empty()); });
+                    if (closing) return;
+                    connection = std::move(connections.front());
+                    connections.pop_front();
+                    answering.push_back(&connection);
+                }
+                answer(connection);
+                std::lock_guard<std::mutex> lock(mutex);
+                answering.erase(std::find(answering.begin(), answering.end(), &connection));
+            }
+        });
+    }
+    while (! stopped_) {
+        os::Socket connection = listener_.accept();
+        if (! connection.valid()) break;
+        std::lock_guard<std::mutex> lock(mutex);
+        connections.push_back(std::move(connection));
+        ready.notify_one();
+    }
+    {
+        // requests being extracted are finished, waiting ones are dropped
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+        for (const os::Socket* connection : answering) {
+            connection->shutdown();
         }
-        end = in.tellg();
+        connections.clear();
     }
-    out << accession << '\t' << accession_version << '\t' << begin << '\t' << (end - begin) << '\n';
-    in.close();
-    out.close();
+    ready.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    unlink(socket_file_.c_str());
+    socket_file_.clear();
 }
 
-void IndexIO::parse(
-    const std::string& file,
-    const std::unordered_set<std::string>& accessions,
-    std::vector<Index>& indexes
-) {
-    std::ifstream in(file);
-    if (! in) {
-        throw std::runtime_error(file + ": Failed to open file");
+void Server::stop() {
+    stopped_ = true;
+    listener_.shutdown();
+}
+
+std::size_t Server::handle(const Request& request) const {
+    Node node;
+    std::uint64_t taxid = 0;
+    if (str::to_uint(str::View(request.id.data(), request.id.size()), taxid) && (taxid <= UINT32_MAX)) {
+        node = taxonomy_.find(taxid);
     }
-    std::string line;
-    std::vector<std::string> row;
-    while (std::getline(in, line)) {
-        str::split(line, '\t', row);
-        if (accessions.find(row[0]) != accessions.end()) {
-            indexes.emplace_back(row[0], row[1], std::stoull(row[2]), std::stoull(row[3]));
+    if (! node.valid()) {
+        throw std::runtime_error(request.id + ": Taxon ID not found");
+    }
+    // files are written with the permissions of the server, only where the client named them exactly
+    for (const std::string* path : {&request.taxa_file, &request.seqs_file}) {
+        if ((! path->empty()) && (os::path::absolute(*path) != *path)) {
+            throw std::runtime_error(*path + ": Output paths must be absolute, without . or .. components");
         }
-        row.clear();
     }
-    in.close();
+    HeaderFilter header_filter(request.header_filter);
+    // concurrent requests share the threads of the server, a request gets one at least
+    struct Lease {
+        const Server& server;
+        unsigned int threads;
+        ~Lease() { server.release(threads); }
+    } lease{*this, this->lease(request.threads)};
+    unsigned int threads = std::max(1u, lease.threads);
+
+    AccessionTable accession_table;  // dropped with the request
+    std::unordered_map<Accession, std::uint32_t> accession2taxid;
+    std::vector<Index> indexes;
+    database_.parse(taxonomy_, {node}, accession_table, accession2taxid, indexes);
+    if (! header_filter.empty()) {
+        filter(header_filter, indexes, threads);
+    }
+    std::vector<std::vector<std::size_t>> selections(1, std::vector<std::size_t>(indexes.size()));
+    for (std::size_t i=0; i<indexes.size(); ++i) {
+        selections[0][i] = i;
+    }
+    std::vector<std::vector<std::size_t>> representatives(1);
+    if ((! request.seqs_file.empty()) && request.dedup) {
+        ResultIO::write_seqs(infile_, indexes, selections, {request.seqs_file}, representatives, threads);
+    }
+    ResultIO::write_taxa(indexes, selections[0], representatives[0], accession2taxid, taxonomy_, request.full_lineage, request.taxa_file);
+    if ((! request.seqs_file.empty()) && (! request.dedup)) {
+        ResultIO::write_seqs(infile_, indexes, selections, {request.seqs_file}, threads);
+    }
+    return indexes.size();
 }
 
-void ResultIO::write_taxa(
-    const std::vector<Index>& indexes,
-    const std::unordered_map<std::string, std::string>& accession2taxid,
-    const std::unordered_map<std::string, Node*>& nodes,
-    bool full_lineage,
-    const std::string& outfile
-) {
-    std::ofstream out(outfile);
-    if (! out) {
-        throw std::runtime_error(outfile + ": Failed to open file");
+unsigned int Server::lease(unsigned int wanted) const {
+    std::lock_guard<std::mutex> lock(budget_mutex_);
+    unsigned int threads = std::min(wanted, idle_threads_);
+    idle_threads_ -= threads;
+    return threads;
+}
+
+void Server::release(unsigned int threads) const {
+    std::lock_guard<std::mutex> lock(budget_mutex_);
+    idle_threads_ += threads;
+}
+
+void Server::filter(const HeaderFilter& filter, std::vector<Index>& indexes, unsigned int threads) const {
+    const std::string description_file = infile_ + ".desc";
+    if (DescriptionIO::filter(description_file, infile_, filter, indexes)) {
+        return;
     }
-    std::string taxid;
-    Node* node = nullptr;
-    bool principal = ! full_lineage;
-    for (const Index& index : indexes) {
-        taxid = accession2taxid.at(index.accession);
-        node = nodes.at(taxid);
-        out << index.accession_version << '\t' << node->lineage(principal) << '\n';
+    std::lock_guard<std::mutex> lock(descriptions_mutex_);
+    if (! DescriptionIO::filter(description_file, infile_, filter, indexes)) {
+        DescriptionIO::create(infile_, description_file, threads);
+        if (! DescriptionIO::filter(description_file, infile_, filter, indexes)) {
+            throw std::runtime_error(description_file + ": Invalid description file");
+        }
     }
-    out.close();
 }
 
-void ResultIO::write_seqs(
-    const std::string& infile,
-    const std::vector<Index>& indexes,
-    const std::string& outfile
-) {
-    std::ifstream in(infile);
-    std::ofstream out(outfile);
-    if (! in) {
-        throw std::runtime_error(infile + ": Failed to open file");
+void Server::answer(os::Socket& connection) const {
+    // a connection may send several requests, each is answered with OK and the number of accessions,
+    // or ERROR and the message
+    try {
+        std::string line;
+        while (connection.read_line(line)) {
+            Request request;
+            std::string reply;
+            try {
+                if (! RequestIO::parse(line, request)) {
+                    throw std::runtime_error("Invalid request");
+                }
+                reply = "OK\t" + std::to_string(handle(request)) + "\n";
+            } catch (const std::exception& exc) {
+                reply = std::string("ERROR\t") + exc.what() + "\n";
+            }
+            connection.write(reply);
+        }
+    } catch (const std::exception&) {
+        // the client went away, nothing to answer
     }
-    if (! out) {
-        throw std::runtime_error(outfile + ": Failed to open file");
+}
+
+std::size_t Client::request(const std::string& socket_file, const Request& request) {
+    Request resolved = request;
+    resolved.taxa_file = os::path::absolute(request.taxa_file);
+    resolved.seqs_file = os::path::absolute(request.seqs_file);
+    for (const std::string* field : {&resolved.id, &resolved.taxa_file, &resolved.seqs_file, &resolved.header_filter}) {
+        if (field->find_first_of("\t\n") != std::string::npos) {
+            throw std::runtime_error(*field + ": Tabs and newlines are not allowed in requests");
+        }
+    }
+    os::Socket connection = os::Socket::connect(socket_file);
+    connection.write(RequestIO::format(resolved));
+    std::string line;
+    if (! connection.read_line(line)) {
+        throw std::runtime_error(socket_file + ": Connection closed by server");
+    }
+    if (str::startswith(line, "ERROR\t")) {
+        throw std::runtime_error(line.substr(6));
     }
-    for (const Index& index : indexes) {
-        std::vector<char> buffer(index.length);
-        in.seekg(index.pos, std::ios::beg);
-        in.read(buffer.data(), index.length);
-        out.write(buffer.data(), index.length);
+    std::uint64_t count = 0;
+    if ((! str::startswith(line, "OK\t")) || (! str::to_uint(str::View(line.data() + 3, line.size() - 3), count))) {
+        throw std::runtime_error(socket_file + ": Invalid reply from server");
     }
+    return count;
 }
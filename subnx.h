@@ -1,69 +1,259 @@
 #ifndef SUBNX_H
 #define SUBNX_H
+#include "utils.h"
 #include <string>
+#include <cstdint>
 #include <vector>
 #include <unordered_set>
 #include <unordered_map>
+#include <atomic>
+#include <chrono>
+#include <regex>
+#include <mutex>
 
-static const std::unordered_set<std::string> PRINCIPALS = {
+// principal ranks from the top down
+static const std::vector<std::string> PRINCIPALS = {
     "kingdom", "phylum", "class", "order", "family", "genus", "species"
 };
+static const std::uint8_t NO_PRINCIPAL = UINT8_MAX;
 static const std::string RANK_DELIMITER = "__";
 
+static const std::uint32_t NO_NODE = UINT32_MAX;
+
 class NameIO {
 public:
-    static void parse(const std::string& file, std::unordered_map<std::string, std::string>& names);
+    static void parse(const std::string& file, std::unordered_map<std::uint32_t, std::string>& names);
 private:
-    static bool is_scientific_name(const std::string& name);
+    static bool is_scientific_name(const str::View& name);
 };
 
+class Taxonomy;
+
+// handle of a node stored in a Taxonomy
 class Node {
 public:
     Node();
-    Node(std::string id, std::string name);
-    Node(std::string id, std::string name, Node* parent, std::string rank);
+    Node(const Taxonomy* tree, std::uint32_t index);
 
+    bool valid() const;
+    std::uint32_t index() const;
+    std::uint32_t taxid() const;
+    std::string name() const;
+    const std::string& rank() const;
+    Node parent() const;
+    std::size_t degree() const;
+    Node child(std::size_t i) const;
     bool is_root() const;
-    void append(Node* child);
-    void trace(std::vector<const Node*>& ancestors) const;
-    void expand(std::vector<const Node*>& descendants) const;
+    void trace(std::vector<Node>& ancestors) const;
+    void expand(std::vector<Node>& descendants) const;
+    std::uint32_t end() const;  // one past the last node of the subtree in pre-order
+    bool contains(const Node& other) const;
     bool is_principal() const;
+    Node principal(std::size_t slot) const;
     std::string str(bool abbr=true) const;
     std::string lineage(bool principal=true) const;
+    bool operator==(const Node& other) const;
+    bool operator!=(const Node& other) const;
+
+private:
+    const Taxonomy* tree_;
+    std::uint32_t index_;
+};
 
+// elements owned by the array or viewed in a mapped file
+template <typename T>
+class Array {
 public:
-    std::string id;
-    std::string name;
-    Node* parent;
-    std::string rank;
-    std::vector<Node*> children;
+    Array() : data_(nullptr), size_(0) {}
+    Array(Array&&) = default;
+    Array& operator=(Array&&) = default;
+    Array(const Array&) = delete;
+    Array& operator=(const Array&) = delete;
+
+    void assign(std::vector<T>&& values) {
+        values_ = std::move(values);
+        data_ = values_.data();
+        size_ = values_.size();
+    }
+    void view(const T* data, std::size_t size) {
+        values_ = std::vector<T>();
+        data_ = data;
+        size_ = size;
+    }
+    const T& operator[](std::size_t i) const { return data_[i]; }
+    const T* data() const { return data_; }
+    std::size_t size() const { return size_; }
+
+private:
+    std::vector<T> values_;
+    const T* data_;
+    std::size_t size_;
+};
+
+// taxonomy tree in flat arrays, nodes are numbered in depth-first pre-order so that every
+// subtree is a contiguous range, and children are stored CSR-style
+class Taxonomy {
+public:
+    Taxonomy();
+    Taxonomy(Taxonomy&&) = default;
+    Taxonomy& operator=(Taxonomy&&) = default;
+
+    void add(std::uint32_t taxid, std::uint32_t parent, const std::string& name, const std::string& rank);
+    void build();
+    std::size_t size() const;
+    bool empty() const;
+    Node at(std::uint32_t index) const;
+    Node find(std::uint32_t taxid) const;
+
+private:
+    std::uint16_t rank_code(const std::string& rank);
+
+private:
+    friend class Node;
+    friend class TaxonomyIO;
+
+    // nodes added but not built yet
+    struct Pending {
+        std::vector<std::uint32_t> taxids;
+        std::vector<std::uint32_t> parents;
+        std::vector<std::uint16_t> ranks;
+        std::vector<std::uint32_t> name_offsets;
+        std::vector<char> names;
+        std::unordered_map<std::string, std::uint16_t> rank_codes;
+    };
+    Pending pending_;
+
+    Array<std::uint32_t> taxids_;        // node to taxid
+    Array<std::uint32_t> parents_;       // node to parent node, NO_NODE for the root
+    Array<std::uint32_t> offsets_;       // node to its first child in children_
+    Array<std::uint32_t> children_;      // child nodes grouped by parent
+    Array<std::uint32_t> ends_;          // node to one past the last node of its subtree
+    Array<std::uint16_t> ranks_;         // node to rank code
+    Array<std::uint32_t> name_offsets_;  // node to its name in names_
+    Array<char> names_;                  // all names, back to back
+    Array<std::uint32_t> lookup_;        // taxid to node, NO_NODE if absent
+    Array<std::uint32_t> ancestors_;     // node to its nearest ancestor of each principal rank
+    Array<std::uint8_t> ordered_;        // node to whether ancestors_ lists its path in order
+    std::vector<std::string> rank_names_;  // rank code to rank
+    std::vector<std::uint8_t> principals_; // rank code to principal slot, NO_PRINCIPAL if none
+    os::MappedFile snapshot_;            // backs the arrays when loaded by TaxonomyIO
+};
+
+// versioned binary snapshot of a parsed taxonomy, tied to the dmp files it came from
+class TaxonomyIO {
+public:
+    static bool load(
+        const std::string& file,
+        const std::string& names_file,
+        const std::string& nodes_file,
+        Taxonomy& taxonomy
+    );
+    static void save(
+        const std::string& file,
+        const std::string& names_file,
+        const std::string& nodes_file,
+        const Taxonomy& taxonomy
+    );
 };
 
 class NodeIO {
 public:
     static void parse(
         const std::string& file,
-        const std::unordered_map<std::string, std::string>& names,
-        std::unordered_map<std::string, Node*>& nodes
+        const std::unordered_map<std::uint32_t, std::string>& names,
+        Taxonomy& taxonomy
     );
-    static void destroy(std::unordered_map<std::string, Node*>& nodes);
 };
 
+class AccessionTable;
+
+// accession packed into 64 bits; the common NCBI formats (uppercase letters, an optional
+// underscore and digits, e.g. AB123456, NC_000001, JAAAAA010000001) are encoded reversibly,
+// anything else refers to its copy in an AccessionTable
+class Accession {
+public:
+    Accession();
+    // packed formats only, throws for any other accession
+    Accession(const char* accession);
+    Accession(const std::string& accession);
+    // any accession, added to table unless it packs
+    Accession(const char* data, std::size_t size, AccessionTable& table);
+    Accession(const std::string& accession, AccessionTable& table);
+
+    // false if the accession does not pack
+    static bool pack(const char* data, std::size_t size, Accession& accession);
+
+    std::string str() const;
+    std::uint64_t key() const;
+    bool packed() const;
+    bool operator==(const Accession& other) const;
+    bool operator!=(const Accession& other) const;
+private:
+    static bool pack(const char* data, std::size_t size, std::uint64_t& key);
+private:
+    std::uint64_t key_;
+};
+
+// accessions that do not pack, each stored once; owned by a run or a request and must outlive
+// the accessions made from it; not thread-safe, parsers add to it from one thread
+class AccessionTable {
+public:
+    AccessionTable();
+    AccessionTable(const AccessionTable&) = delete;
+    AccessionTable& operator=(const AccessionTable&) = delete;
+
+    std::size_t size() const;
+private:
+    friend class Accession;
+    std::unordered_set<std::string> names_;  // elements keep their address
+};
+
+namespace std {
+    template <>
+    struct hash<Accession> {
+        std::size_t operator()(const Accession& accession) const {
+            std::uint64_t key = accession.key() * 0x9e3779b97f4a7c15ULL;  // spread sequential accessions
+            return static_cast<std::size_t>(key ^ (key >> 32));
+        }
+    };
+}
+
 class Accession2TaxIdIO {
 public:
-    static void parse(
+    // returns the number of lines scanned
+    static std::uint64_t parse(
         const std::string& file,
-        const std::unordered_set<std::string>& taxids,
-        std::unordered_map<std::string, std::string>& accession2taxid
+        const Taxonomy& taxonomy,
+        const std::vector<Node>& nodes,
+        AccessionTable& accession_table,
+        std::unordered_map<Accession, std::uint32_t>& accession2taxid,
+        unsigned int threads=1
+    );
+};
+
+// accession2taxid grouped by taxid, built once and mapped read-only,
+// a lookup reads only the postings of the requested taxids
+class Accession2TaxIdTableIO {
+public:
+    // all rows are sorted in memory, about 50 bytes per line
+    static void create(const std::string& infile, const std::string& outfile, unsigned int threads=1);
+    // false if the table is missing, invalid or was built from another version of source_file
+    static bool parse(
+        const std::string& file,
+        const std::string& source_file,
+        const Taxonomy& taxonomy,
+        const std::vector<Node>& nodes,
+        AccessionTable& accession_table,
+        std::unordered_map<Accession, std::uint32_t>& accession2taxid
     );
 };
 
 class Index {
 public:
     Index();
-    Index(std::string accession, std::string accession_version, std::size_t pos, std::size_t length);
+    Index(Accession accession, std::string accession_version, std::size_t pos, std::size_t length);
 public:
-    std::string accession;
+    Accession accession;
     std::string accession_version;
     std::size_t pos;
     std::size_t length;
@@ -71,28 +261,305 @@ public:
 
 class IndexIO {
 public:
-    static void create(const std::string& infile, const std::string& outfile);
+    static void create(const std::string& infile, const std::string& outfile, unsigned int threads=1);
+    static void parse(
+        const std::string& file,
+        const std::unordered_set<Accession>& accessions,
+        std::vector<Index>& indexes
+    );
+};
+
+// sorted binary index, mapped read-only and searched by accession; the header stamps the
+// sequences file it was built from
+class BinaryIndexIO {
+public:
+    enum Status {
+        CURRENT,  // built from the sequences file as it is
+        APPENDED,  // the sequences file grew since, append() indexes the new records
+        STALE  // missing, invalid or built from another file, create() it again
+    };
+public:
+    static void create(const std::string& infile, const std::string& outfile, unsigned int threads=1);
+    static Status check(const std::string& infile, const std::string& file);
+    // index only the records after the old end of infile and rewrite file with them
+    static void append(const std::string& infile, const std::string& file, unsigned int threads=1);
+    // import a text index of source_file
+    static void convert(const std::string& infile, const std::string& outfile, const std::string& source_file);
+    static void dump(const std::string& file, const std::string& outfile);
     static void parse(
         const std::string& file,
-        const std::unordered_set<std::string>& accessions,
+        const std::unordered_set<Accession>& accessions,
         std::vector<Index>& indexes
     );
 };
 
+// selects records by the description of their header, the text after the accession.version
+class HeaderFilter {
+public:
+    // "text" keeps descriptions containing text, "/regex/" those matching an ECMAScript regular
+    // expression anywhere, either prefixed with '!' to drop them instead; an empty spec keeps all
+    explicit HeaderFilter(const std::string& spec="");
+
+    bool empty() const;
+    bool keeps(const char* description, std::size_t size) const;
+private:
+    bool exclude_;
+    bool is_regex_;
+    std::string text_;
+    std::regex regex_;
+};
+
+// header descriptions of a sequences file kept apart from the index, so that records can be
+// filtered by them without reading any sequence
+class DescriptionIO {
+public:
+    static void create(const std::string& infile, const std::string& outfile, unsigned int threads=1);
+    // false if the store is missing, invalid or was built from another version of source_file,
+    // otherwise drops the indexes whose description the filter does not keep
+    static bool filter(
+        const std::string& file,
+        const std::string& source_file,
+        const HeaderFilter& filter,
+        std::vector<Index>& indexes
+    );
+};
+
+// accession2taxid joined with the sequences index once, the sequences of every node are stored
+// in taxonomy pre-order so that a subtree is one contiguous range
+class DatabaseIO {
+public:
+    // all accession2taxid rows are sorted in memory, about 50 bytes per line
+    static void create(
+        const std::string& file,
+        const std::string& names_file,
+        const std::string& nodes_file,
+        const std::string& accession2taxid_file,
+        const std::string& infile,
+        const std::string& index_file,
+        const Taxonomy& taxonomy,
+        unsigned int threads=1
+    );
+    // false if the database is missing, invalid or was built from other versions of the input files
+    static bool parse(
+        const std::string& file,
+        const std::string& names_file,
+        const std::string& nodes_file,
+        const std::string& accession2taxid_file,
+        const std::string& infile,
+        const Taxonomy& taxonomy,
+        const std::vector<Node>& nodes,
+        AccessionTable& accession_table,
+        std::unordered_map<Accession, std::uint32_t>& accession2taxid,
+        std::vector<Index>& indexes
+    );
+};
+
+// the database kept mapped in memory, so that many subtrees are read without opening it again
+class Database {
+public:
+    Database();
+    // false if the database is missing, invalid or was built from other versions of the input files
+    bool load(
+        const std::string& file,
+        const std::string& names_file,
+        const std::string& nodes_file,
+        const std::string& accession2taxid_file,
+        const std::string& infile,
+        const Taxonomy& taxonomy
+    );
+    void parse(
+        const Taxonomy& taxonomy,
+        const std::vector<Node>& nodes,
+        AccessionTable& accession_table,
+        std::unordered_map<Accession, std::uint32_t>& accession2taxid,
+        std::vector<Index>& indexes
+    ) const;
+private:
+    os::MappedFile file_;
+};
+
+// one taxon to extract and where to write it
+class Target {
+public:
+    Target();
+    Target(std::string id, std::string taxa_file, std::string seqs_file);
+public:
+    std::string id;
+    std::string taxa_file;
+    std::string seqs_file;  // empty if sequences are not written
+};
+
+class TargetIO {
+public:
+    static void parse(const std::string& file, std::vector<Target>& targets);
+};
+
 class ResultIO {
 public:
+    static void select(
+        const std::vector<Index>& indexes,
+        const std::unordered_map<Accession, std::uint32_t>& accession2taxid,
+        const Taxonomy& taxonomy,
+        const Node& node,
+        std::vector<std::size_t>& selection
+    );
+    static void write_taxa(
+        const std::vector<Index>& indexes,
+        const std::unordered_map<Accession, std::uint32_t>& accession2taxid,
+        const Taxonomy& taxonomy,
+        bool full_lineage,
+        const std::string& outfile
+    );
+    static void write_taxa(
+        const std::vector<Index>& indexes,
+        const std::vector<std::size_t>& selection,
+        const std::unordered_map<Accession, std::uint32_t>& accession2taxid,
+        const Taxonomy& taxonomy,
+        bool full_lineage,
+        const std::string& outfile
+    );
+    // with a third column naming the record written in place of each one, see write_seqs
     static void write_taxa(
         const std::vector<Index>& indexes,
-        const std::unordered_map<std::string, std::string>& accession2taxid,
-        const std::unordered_map<std::string, Node*>& nodes,
+        const std::vector<std::size_t>& selection,
+        const std::vector<std::size_t>& representatives,
+        const std::unordered_map<Accession, std::uint32_t>& accession2taxid,
+        const Taxonomy& taxonomy,
         bool full_lineage,
         const std::string& outfile
     );
     static void write_seqs(
         const std::string& infile,
         const std::vector<Index>& indexes,
-        const std::string& outfile
+        const std::string& outfile,
+        unsigned int threads=1
+    );
+    static void write_seqs(
+        const std::string& infile,
+        const std::vector<Index>& indexes,
+        const std::vector<std::vector<std::size_t>>& selections,
+        const std::vector<std::string>& outfiles,
+        unsigned int threads=1
+    );
+    // deduplicated: records are read once in file order and a record whose sequence (line breaks
+    // ignored) was already written to the same output is skipped; representatives[k][j] is the
+    // index of the record written for selections[k][j]; only fingerprints are kept in memory,
+    // plus up to 4 MiB of the current record of a compressed file, which spills the rest next to
+    // outfiles[0]; threads hash records of a plain file
+    static void write_seqs(
+        const std::string& infile,
+        const std::vector<Index>& indexes,
+        const std::vector<std::vector<std::size_t>>& selections,
+        const std::vector<std::string>& outfiles,
+        std::vector<std::vector<std::size_t>>& representatives,
+        unsigned int threads=1
     );
 };
 
+// elapsed time, bytes, records and peak memory of each stage of a run
+class Metrics {
+public:
+    class Stage {
+    public:
+        std::string name;
+        double seconds;
+        std::uint64_t input_bytes;  // sizes of the files read
+        std::uint64_t output_bytes;  // sizes of the files written
+        std::uint64_t io_read_bytes;  // read from storage, page cache hits excluded
+        std::uint64_t io_write_bytes;
+        std::int64_t records_scanned;  // -1 if not counted
+        std::int64_t records_matched;
+        std::uint64_t peak_rss;
+    };
+public:
+    Metrics();
+    void start(const std::string& name);
+    // finish the stage started last, inputs and outputs are sized now
+    void stop(
+        const std::vector<std::string>& inputs,
+        const std::vector<std::string>& outputs,
+        std::int64_t records_scanned,
+        std::int64_t records_matched
+    );
+    // drop the stage started last, e.g. when a cached file turned out to be stale
+    void cancel();
+    double elapsed() const;  // seconds since construction
+    const std::vector<Stage>& stages() const;
+private:
+    std::chrono::steady_clock::time_point created_;
+    std::chrono::steady_clock::time_point started_;
+    std::uint64_t io_read_bytes_;
+    std::uint64_t io_write_bytes_;
+    std::vector<Stage> stages_;
+};
+
+class MetricsIO {
+public:
+    static void write(const std::string& file, const Metrics& metrics, const std::string& command, unsigned int threads);
+};
+
+// one extraction request to a resident server
+class Request {
+public:
+    Request();
+    Request(std::string id, std::string taxa_file, std::string seqs_file, bool full_lineage);
+public:
+    std::string id;
+    std::string taxa_file;
+    std::string seqs_file;  // empty if sequences are not written
+    bool full_lineage;
+    bool dedup;  // see ResultIO::write_seqs
+    unsigned int threads;  // for writing sequences, at most those of the server
+    std::string header_filter;  // see HeaderFilter, empty to keep all records
+};
+
+// requests are sent as one tab-separated line: taxon ID, taxa file, sequences file, 0 or 1 for the
+// lineage mode, 0 or 1 for deduplication, threads and the header filter
+class RequestIO {
+public:
+    static std::string format(const Request& request);
+    static bool parse(const std::string& line, Request& request);
+};
+
+// answers requests on a unix domain socket with the taxonomy and the database kept in memory,
+// so that the latency of a request depends only on the size of its result
+class Server {
+public:
+    Server(const Taxonomy& taxonomy, const Database& database, std::string infile, unsigned int threads=1);
+    ~Server();
+    // bind socket_file, called before serve() and before stop() may be called
+    void listen(const std::string& socket_file);
+    // accept connections until stop() is called, requests are answered on a pool of threads
+    void serve();
+    // safe to call from a signal handler once listen() has returned
+    void stop();
+    // extract one request, returns the number of accessions written; output paths must be
+    // absolute and free of . and .. components
+    std::size_t handle(const Request& request) const;
+private:
+    void answer(os::Socket& connection) const;
+    void filter(const HeaderFilter& filter, std::vector<Index>& indexes, unsigned int threads) const;
+    // take up to wanted threads from the budget shared by the requests being extracted
+    unsigned int lease(unsigned int wanted) const;
+    void release(unsigned int threads) const;
+private:
+    const Taxonomy& taxonomy_;
+    const Database& database_;
+    std::string infile_;
+    unsigned int threads_;
+    std::string socket_file_;
+    os::Socket listener_;  // not reassigned while serving, stop() reads it without a lock
+    std::atomic<bool> stopped_;
+    mutable std::mutex descriptions_mutex_;  // the description store is built by one request only
+    mutable std::mutex budget_mutex_;
+    mutable unsigned int idle_threads_;  // threads_ less the threads leased to requests
+};
+
+class Client {
+public:
+    // send a request to the server on socket_file and wait for it, relative output paths are resolved here;
+    // errors of the server are thrown, otherwise returns the number of accessions written
+    static std::size_t request(const std::string& socket_file, const Request& request);
+};
+
 #endif
@@ -3,6 +3,8 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <zlib.h>
+#include <thread>
 using namespace std;
 
 template <typename T>
@@ -53,20 +55,361 @@ void assert_false(bool actual) {
     }
 }
 
+string read_file(const string& file) {
+    ifstream in(file);
+    ostringstream oss;
+    oss << in.rdbuf();
+    return oss.str();
+}
+
+class TestFields {
+public:
+    void test_split() {
+        cout << "Test str::Fields<Columns, Used>::split(const string&)" << endl;
+        str::Fields<13, 3> row("\t|\t");
+        string line = "5455\t|\t681950\t|\tgenus\t|\t\t|\t4\t|\t1\t|\t1\t|\t1\t|\t4\t|\t1\t|\t0\t|\t0\t|\t\t|";
+        assert_true(row.split(line));
+        assert_equal(row[0].str(), string("5455"));
+        assert_equal(row[1].str(), string("681950"));
+        assert_equal(row[2].str(), string("genus"));
+        line = "5455\t|\tColletotrichum\t|\t\t|\tscientific name\t|";
+        assert_false(row.split(line));
+    }
+    void test_split_columns() {
+        cout << "Test str::Fields<Columns, Used>::split(const char*, const char*)" << endl;
+        str::Fields<4> row("\t");
+        string line = "X17276\tX17276.1\t4890\t1";
+        assert_true(row.split(line.data(), line.data() + line.size()));
+        assert_true(row[0] == "X17276");
+        assert_true(row[3] == "1");
+        line = "\t\t\t";
+        assert_true(row.split(line));
+        assert_true(row[0] == "");
+        assert_true(row[3] == "");
+        line = "X17276\tX17276.1\t4890";
+        assert_false(row.split(line));
+        line = "X17276\tX17276.1\t4890\t1\t";
+        assert_false(row.split(line));
+    }
+    void test_to_uint() {
+        cout << "Test str::to_uint(const View&, uint64_t&)" << endl;
+        uint64_t value = 0;
+        string digits = "378000000000";
+        assert_true(str::to_uint(str::View(digits.data(), digits.size()), value));
+        assert_equal(value, uint64_t(378000000000ULL));
+        assert_false(str::to_uint(str::View("12a", 3), value));
+        assert_false(str::to_uint(str::View("", 0), value));
+        assert_true(str::to_uint(str::View("18446744073709551615", 20), value));
+        assert_equal(value, uint64_t(UINT64_MAX));
+        assert_false(str::to_uint(str::View("18446744073709551616", 20), value));
+        assert_false(str::to_uint(str::View("18446744073709551617", 20), value));
+        assert_false(str::to_uint(str::View("99999999999999999999", 20), value));
+    }
+    void test() {
+        cout << "Test str::Fields" << endl;
+        test_split();
+        test_split_columns();
+        test_to_uint();
+    }
+};
+
+// gzip content as a single member
+void write_gzip(const string& file, const string& content) {
+    gzFile out = gzopen(file.c_str(), "wb");
+    gzwrite(out, content.data(), content.size());
+    gzclose(out);
+}
+
+// bgzip content in blocks of block_size bytes, followed by the empty end-of-file block
+void write_bgzf(const string& file, const string& content, size_t block_size) {
+    ofstream out(file, ios::binary);
+    for (size_t pos=0; ; pos+=block_size) {
+        size_t n = (pos < content.size()) ? min(block_size, content.size() - pos) : 0;
+        string deflated(compressBound(n) + 16, '\0');
+        z_stream stream{};
+        deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(content.data() + pos));
+        stream.avail_in = n;
+        stream.next_out = reinterpret_cast<Bytef*>(&deflated[0]);
+        stream.avail_out = deflated.size();
+        deflate(&stream, Z_FINISH);
+        deflated.resize(stream.total_out);
+        deflateEnd(&stream);
+        size_t bsize = 18 + deflated.size() + 8 - 1;
+        unsigned char header[18] = {0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0,
+                                    static_cast<unsigned char>(bsize & 0xff), static_cast<unsigned char>(bsize >> 8)};
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        out.write(deflated.data(), deflated.size());
+        uint32_t trailer[2] = {static_cast<uint32_t>(crc32(0, reinterpret_cast<const Bytef*>(content.data() + pos), n)),
+                               static_cast<uint32_t>(n)};
+        out.write(reinterpret_cast<const char*>(trailer), sizeof(trailer));
+        if (n == 0) break;
+    }
+    out.close();
+}
+
+// the lineage of Colletotrichum lagenaria and a sibling species, as in test-data/taxdmp
+void build_taxonomy(Taxonomy& taxonomy) {
+    taxonomy.add(1, 1, "root", "no rank");
+    taxonomy.add(131567, 1, "cellular organisms", "cellular root");
+    taxonomy.add(2759, 131567, "Eukaryota", "domain");
+    taxonomy.add(33154, 2759, "Opisthokonta", "clade");
+    taxonomy.add(4751, 33154, "Fungi", "kingdom");
+    taxonomy.add(451864, 4751, "Dikarya", "subkingdom");
+    taxonomy.add(4890, 451864, "Ascomycota", "phylum");
+    taxonomy.add(716545, 4890, "saccharomyceta", "clade");
+    taxonomy.add(147538, 716545, "Pezizomycotina", "subphylum");
+    taxonomy.add(716546, 147538, "leotiomyceta", "clade");
+    taxonomy.add(715989, 716546, "sordariomyceta", "clade");
+    taxonomy.add(147550, 715989, "Sordariomycetes", "class");
+    taxonomy.add(222543, 147550, "Hypocreomycetidae", "subclass");
+    taxonomy.add(1028384, 222543, "Glomerellales", "order");
+    taxonomy.add(681950, 1028384, "Glomerellaceae", "family");
+    taxonomy.add(5455, 681950, "Colletotrichum", "genus");
+    taxonomy.add(5462, 5455, "Colletotrichum lagenaria", "species");
+    taxonomy.add(27358, 5455, "Colletotrichum coccodes", "species");
+    taxonomy.build();
+}
+
+static const vector<uint32_t> LINEAGE_5462 = {
+    5462, 5455, 681950, 1028384, 222543, 147550, 715989, 716546, 147538,
+    716545, 4890, 451864, 4751, 33154, 2759, 131567, 1
+};
+
+class TestGzipReader {
+public:
+    void test_next() {
+        cout << "Test GzipReader::next(string&)" << endl;
+        string content;
+        for (int i=0; i<1000; ++i) {
+            content += to_string(i) + "\n";
+        }
+        write_gzip("test-data/numbers.gz", content);
+        assert_true(os::path::is_gzip("test-data/numbers.gz"));
+        assert_false(os::path::is_gzip("test-data/nt"));
+        os::GzipReader in("test-data/numbers.gz", 7, 2);
+        string block;
+        string actual;
+        uint64_t offset = 0;
+        while (in.next(block)) {
+            assert_true(block.size() <= size_t(7));
+            assert_true(in.tell() >= offset);
+            offset = in.tell();
+            actual += block;
+        }
+        assert_equal(actual, content);
+        assert_equal(in.tell(), os::path::size("test-data/numbers.gz"));
+    }
+    void test_invalid() {
+        cout << "Test GzipReader::next(string&) (truncated)" << endl;
+        string compressed = read_file("test-data/numbers.gz");
+        ofstream out("test-data/truncated.gz", ios::binary);
+        out << compressed.substr(0, compressed.size() / 2);
+        out.close();
+        bool thrown = false;
+        try {
+            os::GzipReader in("test-data/truncated.gz");
+            string block;
+            while (in.next(block)) {}
+        } catch (const runtime_error&) {
+            thrown = true;
+        }
+        assert_true(thrown);
+    }
+    void test() {
+        cout << "Test GzipReader" << endl;
+        test_next();
+        test_invalid();
+    }
+};
+
+class TestAtomicFile {
+public:
+    void test_commit() {
+        cout << "Test AtomicFile::commit()" << endl;
+        {
+            os::AtomicFile atomic("test-data/atomic.txt");
+            atomic.stream() << "old\n";
+            atomic.commit();
+        }
+        assert_equal(read_file("test-data/atomic.txt"), string("old\n"));
+        {
+            os::AtomicFile atomic("test-data/atomic.txt");
+            atomic.stream() << "new\n";
+            assert_equal(read_file("test-data/atomic.txt"), string("old\n"));  // replaced only on commit
+            atomic.commit();
+        }
+        assert_equal(read_file("test-data/atomic.txt"), string("new\n"));
+    }
+    void test_abandon() {
+        cout << "Test AtomicFile::~AtomicFile()" << endl;
+        try {
+            os::AtomicFile atomic("test-data/atomic.txt");
+            atomic.stream() << "partial";
+            throw runtime_error("interrupted");
+        } catch (const runtime_error&) {
+        }
+        assert_equal(read_file("test-data/atomic.txt"), string("new\n"));
+        bool thrown = false;
+        try {
+            os::AtomicFile atomic("test-data/missing/atomic.txt");
+        } catch (const runtime_error&) {
+            thrown = true;
+        }
+        assert_true(thrown);
+    }
+    void test() {
+        cout << "Test AtomicFile" << endl;
+        test_commit();
+        test_abandon();
+    }
+};
+
+class TestBgzfFile {
+public:
+    void test_read() {
+        cout << "Test BgzfFile::read(uint64_t, size_t, string&)" << endl;
+        string content;
+        for (int i=0; i<1000; ++i) {
+            content += to_string(i) + "\n";
+        }
+        write_bgzf("test-data/numbers.bgz", content, 100);
+        assert_true(os::path::is_bgzf("test-data/numbers.bgz"));
+        assert_false(os::path::is_bgzf("test-data/numbers.gz"));
+        for (size_t cache_size : {1u, 64u}) {
+            os::BgzfFile in("test-data/numbers.bgz", cache_size);
+            for (size_t pos : {0u, 99u, 100u, 1234u, 3800u}) {
+                for (size_t length : {0u, 1u, 150u, 250u}) {
+                    string actual;
+                    in.read(pos, min(length, content.size() - pos), actual);
+                    assert_equal(actual, content.substr(pos, length));
+                }
+            }
+        }
+    }
+    void test_scan() {
+        cout << "Test BgzfFile::scan(const string&, vector<Block>&)" << endl;
+        vector<os::BgzfFile::Block> blocks;
+        os::BgzfFile::scan("test-data/numbers.bgz", blocks);
+        assert_equal(blocks.size(), size_t(40));  // 3890 bytes in blocks of 100, and the end-of-file block
+        assert_equal(blocks[0].uoffset, uint64_t(0));
+        assert_equal(blocks[1].uoffset, uint64_t(100));
+        assert_equal(blocks[39].uoffset, uint64_t(3890));
+        os::BgzfFile::save("test-data/numbers.bgz.gzi", "test-data/numbers.bgz", blocks);
+        vector<os::BgzfFile::Block> loaded;
+        assert_true(os::BgzfFile::load("test-data/numbers.bgz.gzi", "test-data/numbers.bgz", loaded));
+        assert_equal(loaded.size(), blocks.size());
+        for (size_t i=0; i<blocks.size(); ++i) {
+            assert_equal(loaded[i].coffset, blocks[i].coffset);
+            assert_equal(loaded[i].uoffset, blocks[i].uoffset);
+        }
+        assert_false(os::BgzfFile::load("test-data/missing.gzi", "test-data/numbers.bgz", loaded));
+    }
+    void test_stale_index() {
+        cout << "Test BgzfFile::load(const string&, const string&, vector<Block>&) (stale)" << endl;
+        string content;
+        for (int i=0; i<1000; ++i) {
+            content += to_string(i) + "\n";
+        }
+        write_bgzf("test-data/stale.bgz", content, 100);
+        vector<os::BgzfFile::Block> blocks;
+        os::BgzfFile::scan("test-data/stale.bgz", blocks);
+        os::BgzfFile::save("test-data/stale.bgz.gzi", "test-data/stale.bgz", blocks);
+
+        // rewritten with other blocks, the stamp no longer matches
+        string other = content.substr(1000) + content.substr(0, 1000);
+        write_bgzf("test-data/stale.bgz", other, 300);
+        vector<os::BgzfFile::Block> loaded;
+        assert_false(os::BgzfFile::load("test-data/stale.bgz.gzi", "test-data/stale.bgz", loaded));
+        string actual;
+        os::BgzfFile("test-data/stale.bgz").read(2500, 500, actual);
+        assert_equal(actual, other.substr(2500, 500));
+        assert_true(os::BgzfFile::load("test-data/stale.bgz.gzi", "test-data/stale.bgz", loaded));  // written back
+
+        // without the stamp, as bgzip -i writes it: the last block must still lie in the file
+        string gzi = read_file("test-data/stale.bgz.gzi");
+        ofstream out("test-data/stale.bgz.gzi", ios::binary);
+        out << gzi.substr(0, gzi.size() - 24);
+        out.close();
+        assert_true(os::BgzfFile::load("test-data/stale.bgz.gzi", "test-data/stale.bgz", loaded));
+        write_bgzf("test-data/stale.bgz", content, 4000);
+        out.open("test-data/stale.bgz.gzi", ios::binary);
+        out << gzi.substr(0, gzi.size() - 24);
+        out.close();
+        assert_false(os::BgzfFile::load("test-data/stale.bgz.gzi", "test-data/stale.bgz", loaded));
+        actual.clear();
+        os::BgzfFile("test-data/stale.bgz").read(2500, 500, actual);
+        assert_equal(actual, content.substr(2500, 500));
+    }
+    void test() {
+        cout << "Test BgzfFile" << endl;
+        test_read();
+        test_scan();
+        test_stale_index();
+    }
+};
+
+class TestAccession {
+public:
+    void test_pack() {
+        cout << "Test Accession::Accession(const string&)" << endl;
+        AccessionTable table;
+        for (string value : {"U00001", "AB000001", "MN90894712", "AAA12345", "ABC1234567", "AAAA01000001",
+                                    "ABCD010000001", "ZZZZ0100000001", "JAAAAA010000001", "ZZZZZ9999999",
+                                    "NC_000001", "XM_123456789", "NZ_12345678"}) {
+            Accession accession(value);
+            assert_true(accession.packed());
+            assert_equal(accession.str(), value);
+            assert_true(accession == Accession(value.data(), value.size(), table));
+        }
+        assert_equal(table.size(), size_t(0));
+        assert_true(Accession("AB000001") != Accession("AB000002"));
+        assert_true(Accession("AB000001") != Accession("AB0000001", table));
+    }
+    void test_table() {
+        cout << "Test Accession::Accession(const char*, size_t, AccessionTable&)" << endl;
+        AccessionTable table;
+        Accession packed;
+        assert_false(Accession::pack("pdb|1ABC|A", 10, packed));
+        for (string value : {"pdb|1ABC|A", "ab000001", "NZ_CP012345", "A", "", "AB00000X"}) {
+            Accession accession(value.data(), value.size(), table);
+            assert_false(accession.packed());
+            assert_equal(accession.str(), value);
+            assert_true(Accession(value, table) == accession);
+        }
+        assert_equal(table.size(), size_t(6));
+        assert_true(Accession::pack("AB000001", 8, packed));
+        assert_equal(packed.str(), string("AB000001"));
+
+        bool thrown = false;
+        try {
+            Accession("pdb|1ABC|A");
+        } catch (const runtime_error&) {
+            thrown = true;
+        }
+        assert_true(thrown);
+    }
+    void test() {
+        cout << "Test Accession" << endl;
+        test_pack();
+        test_table();
+    }
+};
+
 class TestNameIO {
 public:
     void test1() {
-        cout << "Test NameIO::parse(const string&, unordered_map<string, string>&)" << endl;
-        unordered_map<string, string> names;
+        cout << "Test NameIO::parse(const string&, unordered_map<uint32_t, string>&)" << endl;
+        unordered_map<uint32_t, string> names;
         NameIO::parse("test-data/taxdmp/names.dmp", names);
         assert_equal(names.size(), size_t(18));
-        assert_equal(names.at("1"), string("root"));
-        assert_equal(names.at("147538"), string("Pezizomycotina"));
-        assert_equal(names.at("1028384"), string("Glomerellales"));
+        assert_equal(names.at(1), string("root"));
+        assert_equal(names.at(147538), string("Pezizomycotina"));
+        assert_equal(names.at(1028384), string("Glomerellales"));
     }
     void test2() {
-        cout << "Test NameIO::parse(const string&, unordered_map<string, string>&) (empty)" << endl;
-        unordered_map<string, string> names;
+        cout << "Test NameIO::parse(const string&, unordered_map<uint32_t, string>&) (empty)" << endl;
+        unordered_map<uint32_t, string> names;
         NameIO::parse("test-data/taxdmp/nodes.dmp", names);
         assert_equal(names.size(), size_t(0));
     }
@@ -80,413 +423,492 @@ public:
 class TestNode {
 public:
     void test_construct_method1() {
-        cout << "Test Node::Node(string, string)" << endl;
-        Node node("1", "root");
-        assert_equal(node.id, string("1"));
-        assert_equal(node.name, string("root"));
-        assert_equal(node.rank, string(""));
-        assert_nullptr(node.parent);
+        cout << "Test Node::Node()" << endl;
+        Node node;
+        assert_false(node.valid());
     }
     void test_construct_method2() {
-        cout << "Test Node::Node(string, string, Node*, string)" << endl;
-        Node parent("1", "root", nullptr, "no rank");
-        Node node("131567", "cellular organisms", &parent, "cellular root");
-        parent.append(&node);
-
-        // parent
-        assert_equal(parent.id, string("1"));
-        assert_equal(parent.name, string("root"));
-        assert_nullptr(parent.parent);
-        assert_equal(parent.rank, string("no rank"));
-        assert_equal(parent.children[0], &node);
-
-        // node
-        assert_equal(node.id, string("131567"));
-        assert_equal(node.name, string("cellular organisms"));
-        assert_equal(node.parent, &parent);
-        assert_equal(node.rank, string("cellular root"));
+        cout << "Test Node::Node(const Taxonomy*, uint32_t)" << endl;
+        Taxonomy taxonomy;
+        build_taxonomy(taxonomy);
+        Node node(&taxonomy, 1);
+        assert_true(node.valid());
+        assert_equal(node.index(), uint32_t(1));
+        assert_equal(node.taxid(), uint32_t(131567));
+        assert_equal(node.name(), string("cellular organisms"));
+        assert_equal(node.rank(), string("cellular root"));
+        assert_equal(node.parent().taxid(), uint32_t(1));
+        assert_true(node == taxonomy.find(131567));
+        assert_true(node != taxonomy.find(1));
     }
     void test_is_root() {
         cout << "Test Node::is_root()" << endl;
-        Node parent("1", "root", nullptr, "no rank");
-        Node node("131567", "cellular organisms", &parent, "cellular root");
-        parent.append(&node);
-        assert_equal(parent.is_root(), true);
-        assert_equal(node.is_root(), false);
+        Taxonomy taxonomy;
+        build_taxonomy(taxonomy);
+        assert_equal(taxonomy.find(1).is_root(), true);
+        assert_equal(taxonomy.find(131567).is_root(), false);
+        assert_false(taxonomy.find(1).parent().valid());
     }
-    void test_append() {
-        cout << "Test Node::append(Node*)" << endl;
-        Node parent("1", "root", nullptr, "no rank");
-        Node node("131567", "cellular organisms", &parent, "cellular root");
-        assert_equal(parent.children.size(), size_t(0));
-        parent.append(&node);
-        assert_equal(parent.children.size(), size_t(1));
-        parent.append(&node);
-        assert_equal(parent.children.size(), size_t(2));
+    void test_child() {
+        cout << "Test Node::child(size_t)" << endl;
+        Taxonomy taxonomy;
+        build_taxonomy(taxonomy);
+        Node root = taxonomy.find(1);
+        assert_equal(root.degree(), size_t(1));
+        assert_equal(root.child(0).taxid(), uint32_t(131567));
+        Node genus = taxonomy.find(5455);
+        assert_equal(genus.degree(), size_t(2));
+        assert_equal(genus.child(0).taxid(), uint32_t(5462));
+        assert_equal(genus.child(1).taxid(), uint32_t(27358));
+        assert_equal(taxonomy.find(27358).degree(), size_t(0));
     }
     void test_trace() {
-        cout << "Test Node::trace(vector<const Node*>)" << endl;
-        Node t1("1", "root", nullptr, "no rank");
-        Node t131567("131567", "cellular organisms", &t1, "cellular root");
-        Node t2759("2759", "Eukaryota", &t131567, "domain");
-        Node t33154("33154", "Opisthokonta", &t2759, "clade");
-        Node t4751("4751", "Fungi", &t33154, "kingdom");
-        Node t451864("451864", "Dikarya", &t4751, "subkingdom");
-        Node t4890("4890", "Ascomycota", &t451864, "phylum");
-        Node t716545("716545", "saccharomyceta", &t4890, "clade");
-        Node t147538("147538", "Pezizomycotina", &t716545, "subphylum");
-        Node t716546("716546", "leotiomyceta", &t147538, "clade");
-        Node t715989("715989", "sordariomyceta", &t716546, "clade");
-        Node t147550("147550", "Sordariomycetes", &t715989, "class");
-        Node t222543("222543", "Hypocreomycetidae", &t147550, "subclass");
-        Node t1028384("1028384", "Glomerellales", &t222543, "order");
-        Node t681950("681950", "Glomerellaceae", &t1028384, "family");
-        Node t5455("5455", "Colletotrichum", &t681950, "genus");
-        Node t5462("5462", "Colletotrichum lagenaria", &t5455, "species");
-        Node t27358("27358", "Colletotrichum coccodes", &t5455, "species");
-        vector<const Node*> ancestors;
-        t5462.trace(ancestors);
-        assert_ptr_equal(ancestors[0], &t5462);
-        assert_ptr_equal(ancestors[1], &t5455);
-        assert_ptr_equal(ancestors[2], &t681950);
-        assert_ptr_equal(ancestors[3], &t1028384);
-        assert_ptr_equal(ancestors[4], &t222543);
-        assert_ptr_equal(ancestors[5], &t147550);
-        assert_ptr_equal(ancestors[6], &t715989);
-        assert_ptr_equal(ancestors[7], &t716546);
-        assert_ptr_equal(ancestors[8], &t147538);
-        assert_ptr_equal(ancestors[9], &t716545);
-        assert_ptr_equal(ancestors[10], &t4890);
-        assert_ptr_equal(ancestors[11], &t451864);
-        assert_ptr_equal(ancestors[12], &t4751);
-        assert_ptr_equal(ancestors[13], &t33154);
-        assert_ptr_equal(ancestors[14], &t2759);
-        assert_ptr_equal(ancestors[15], &t131567);
-        assert_ptr_equal(ancestors[16], &t1);
+        cout << "Test Node::trace(vector<Node>&)" << endl;
+        Taxonomy taxonomy;
+        build_taxonomy(taxonomy);
+        vector<Node> ancestors;
+        taxonomy.find(5462).trace(ancestors);
+        assert_equal(ancestors.size(), LINEAGE_5462.size());
+        for (size_t i=0; i<ancestors.size(); ++i) {
+            assert_equal(ancestors[i].taxid(), LINEAGE_5462[i]);
+        }
     }
     void test_expand() {
-        cout << "Test Node::trace(vector<const Node*>)" << endl;
-        Node t1("1", "root", nullptr, "no rank");
-        Node t131567("131567", "cellular organisms", &t1, "cellular root");
-        Node t2759("2759", "Eukaryota", &t131567, "domain");
-        Node t33154("33154", "Opisthokonta", &t2759, "clade");
-        Node t4751("4751", "Fungi", &t33154, "kingdom");
-        Node t451864("451864", "Dikarya", &t4751, "subkingdom");
-        Node t4890("4890", "Ascomycota", &t451864, "phylum");
-        Node t716545("716545", "saccharomyceta", &t4890, "clade");
-        Node t147538("147538", "Pezizomycotina", &t716545, "subphylum");
-        Node t716546("716546", "leotiomyceta", &t147538, "clade");
-        Node t715989("715989", "sordariomyceta", &t716546, "clade");
-        Node t147550("147550", "Sordariomycetes", &t715989, "class");
-        Node t222543("222543", "Hypocreomycetidae", &t147550, "subclass");
-        Node t1028384("1028384", "Glomerellales", &t222543, "order");
-        Node t681950("681950", "Glomerellaceae", &t1028384, "family");
-        Node t5455("5455", "Colletotrichum", &t681950, "genus");
-        Node t5462("5462", "Colletotrichum lagenaria", &t5455, "species");
-        Node t27358("27358", "Colletotrichum coccodes", &t5455, "species");
-        t1.append(&t131567);
-        t131567.append(&t2759);
-        t2759.append(&t33154);
-        t33154.append(&t4751);
-        t4751.append(&t451864);
-        t451864.append(&t4890);
-        t4890.append(&t716545);
-        t716545.append(&t147538);
-        t147538.append(&t716546);
-        t716546.append(&t715989);
-        t715989.append(&t147550);
-        t147550.append(&t222543);
-        t222543.append(&t1028384);
-        t1028384.append(&t681950);
-        t681950.append(&t5455);
-        t5455.append(&t5462);
-        t5455.append(&t27358);
-        vector<const Node*> descendants;
-        t1.expand(descendants);
-        assert_ptr_equal(descendants[0], &t1);
-        assert_ptr_equal(descendants[1], &t131567);
-        assert_ptr_equal(descendants[2], &t2759);
-        assert_ptr_equal(descendants[3], &t33154);
-        assert_ptr_equal(descendants[4], &t4751);
-        assert_ptr_equal(descendants[5], &t451864);
-        assert_ptr_equal(descendants[6], &t4890);
-        assert_ptr_equal(descendants[7], &t716545);
-        assert_ptr_equal(descendants[8], &t147538);
-        assert_ptr_equal(descendants[9], &t716546);
-        assert_ptr_equal(descendants[10], &t715989);
-        assert_ptr_equal(descendants[11], &t147550);
-        assert_ptr_equal(descendants[12], &t222543);
-        assert_ptr_equal(descendants[13], &t1028384);
-        assert_ptr_equal(descendants[14], &t681950);
-        assert_ptr_equal(descendants[15], &t5455);
-        assert_ptr_equal(descendants[16], &t5462);
-        assert_ptr_equal(descendants[17], &t27358);
+        cout << "Test Node::expand(vector<Node>&)" << endl;
+        Taxonomy taxonomy;
+        build_taxonomy(taxonomy);
+        vector<Node> descendants;
+        taxonomy.find(1).expand(descendants);
+        vector<uint32_t> expected = {
+            1, 131567, 2759, 33154, 4751, 451864, 4890, 716545, 147538,
+            716546, 715989, 147550, 222543, 1028384, 681950, 5455, 5462, 27358
+        };
+        assert_equal(descendants.size(), expected.size());
+        for (size_t i=0; i<descendants.size(); ++i) {
+            assert_equal(descendants[i].taxid(), expected[i]);
+        }
+        descendants.clear();
+        taxonomy.find(27358).expand(descendants);
+        assert_equal(descendants.size(), size_t(1));
+        assert_equal(descendants[0].taxid(), uint32_t(27358));
+    }
+    void test_contains() {
+        cout << "Test Node::contains(const Node&)" << endl;
+        Taxonomy taxonomy;
+        taxonomy.add(27358, 5455, "Colletotrichum coccodes", "species");
+        taxonomy.add(5455, 1, "Colletotrichum", "genus");
+        taxonomy.add(1, 1, "root", "no rank");
+        taxonomy.add(2, 1, "Bacteria", "domain");
+        taxonomy.add(5462, 5455, "Colletotrichum lagenaria", "species");
+        taxonomy.build();
+        Node root = taxonomy.find(1);
+        Node genus = taxonomy.find(5455);
+        assert_equal(root.index(), uint32_t(0));
+        assert_equal(root.end(), uint32_t(5));
+        assert_equal(genus.end() - genus.index(), uint32_t(3));
+        assert_true(genus.contains(genus));
+        assert_true(genus.contains(taxonomy.find(27358)));
+        assert_true(genus.contains(taxonomy.find(5462)));
+        assert_false(genus.contains(taxonomy.find(2)));
+        assert_false(genus.contains(root));
+        assert_false(genus.contains(taxonomy.find(3)));
+        assert_true(root.contains(taxonomy.find(2)));
+        vector<Node> descendants;
+        genus.expand(descendants);
+        assert_equal(descendants.size(), size_t(3));
+        assert_equal(descendants[1].taxid(), uint32_t(27358));
+        assert_equal(descendants[2].taxid(), uint32_t(5462));
     }
     void test_is_principal() {
         cout << "Test Node::is_principal()" << endl;
-        Node t1("1", "root", nullptr, "no rank");
-        assert_false(t1.is_principal());
-        Node t131567("131567", "cellular organisms", &t1, "cellular root");
-        assert_false(t131567.is_principal());
-        Node t2759("2759", "Eukaryota", &t131567, "domain");
-        assert_false(t2759.is_principal());
-        Node t33154("33154", "Opisthokonta", &t2759, "clade");
-        assert_false(t33154.is_principal());
-        Node t4751("4751", "Fungi", &t33154, "kingdom");
-        assert_true(t4751.is_principal());
-        Node t451864("451864", "Dikarya", &t4751, "subkingdom");
-        assert_false(t451864.is_principal());
-        Node t4890("4890", "Ascomycota", &t451864, "phylum");
-        assert_true(t4890.is_principal());
-        Node t716545("716545", "saccharomyceta", &t4890, "clade");
-        assert_false(t716545.is_principal());
-        Node t147538("147538", "Pezizomycotina", &t716545, "subphylum");
-        assert_false(t147538.is_principal());
-        Node t716546("716546", "leotiomyceta", &t147538, "clade");
-        assert_false(t716546.is_principal());
-        Node t715989("715989", "sordariomyceta", &t716546, "clade");
-        assert_false(t715989.is_principal());
-        Node t147550("147550", "Sordariomycetes", &t715989, "class");
-        assert_true(t147550.is_principal());
-        Node t222543("222543", "Hypocreomycetidae", &t147550, "subclass");
-        assert_false(t222543.is_principal());
-        Node t1028384("1028384", "Glomerellales", &t222543, "order");
-        assert_true(t1028384.is_principal());
-        Node t681950("681950", "Glomerellaceae", &t1028384, "family");
-        assert_true(t681950.is_principal());
-        Node t5455("5455", "Colletotrichum", &t681950, "genus");
-        assert_true(t5455.is_principal());
-        Node t5462("5462", "Colletotrichum lagenaria", &t5455, "species");
-        assert_true(t5462.is_principal());
-        Node t27358("27358", "Colletotrichum coccodes", &t5455, "species");
-        assert_true(t27358.is_principal());
+        Taxonomy taxonomy;
+        build_taxonomy(taxonomy);
+        unordered_set<uint32_t> principals = {4751, 4890, 147550, 1028384, 681950, 5455, 5462, 27358};
+        for (size_t i=0; i<taxonomy.size(); ++i) {
+            Node node = taxonomy.at(i);
+            assert_equal(node.is_principal(), principals.count(node.taxid()) == 1);
+        }
     }
     void test_str() {
         cout << "Test Node::str()" << endl;
-        Node t1("1", "root", nullptr, "no rank");
+        Taxonomy taxonomy;
+        build_taxonomy(taxonomy);
+        Node t1 = taxonomy.find(1);
         assert_equal(t1.str(), string("no_rank__root"));
         assert_equal(t1.str(true), string("no_rank__root"));
         assert_equal(t1.str(false), string("no_rank__root"));
-        Node t5462("5462", "Colletotrichum lagenaria", nullptr, "species");
+        Node t5462 = taxonomy.find(5462);
         assert_equal(t5462.str(), string("s__Colletotrichum_lagenaria"));
         assert_equal(t5462.str(true), string("s__Colletotrichum_lagenaria"));
         assert_equal(t5462.str(false), string("species__Colletotrichum_lagenaria"));
     }
     void test_lineage() {
         cout << "Test Node::lineage()" << endl;
-        Node t1("1", "root", nullptr, "no rank");
-        Node t131567("131567", "cellular organisms", &t1, "cellular root");
-        Node t2759("2759", "Eukaryota", &t131567, "domain");
-        Node t33154("33154", "Opisthokonta", &t2759, "clade");
-        Node t4751("4751", "Fungi", &t33154, "kingdom");
-        Node t451864("451864", "Dikarya", &t4751, "subkingdom");
-        Node t4890("4890", "Ascomycota", &t451864, "phylum");
-        Node t716545("716545", "saccharomyceta", &t4890, "clade");
-        Node t147538("147538", "Pezizomycotina", &t716545, "subphylum");
-        Node t716546("716546", "leotiomyceta", &t147538, "clade");
-        Node t715989("715989", "sordariomyceta", &t716546, "clade");
-        Node t147550("147550", "Sordariomycetes", &t715989, "class");
-        Node t222543("222543", "Hypocreomycetidae", &t147550, "subclass");
-        Node t1028384("1028384", "Glomerellales", &t222543, "order");
-        Node t681950("681950", "Glomerellaceae", &t1028384, "family");
-        Node t5455("5455", "Colletotrichum", &t681950, "genus");
-        Node t5462("5462", "Colletotrichum lagenaria", &t5455, "species");
-        Node t27358("27358", "Colletotrichum coccodes", &t5455, "species");
+        Taxonomy taxonomy;
+        build_taxonomy(taxonomy);
+        Node t5462 = taxonomy.find(5462);
         string lineage = "k__Fungi; p__Ascomycota; c__Sordariomycetes; o__Glomerellales; f__Glomerellaceae; g__Colletotrichum; s__Colletotrichum_lagenaria";
         string full_lineage = "no_rank__root; cellular_root__cellular_organisms; domain__Eukaryota; clade__Opisthokonta; kingdom__Fungi; subkingdom__Dikarya; phylum__Ascomycota; clade__saccharomyceta; subphylum__Pezizomycotina; clade__leotiomyceta; clade__sordariomyceta; class__Sordariomycetes; subclass__Hypocreomycetidae; order__Glomerellales; family__Glomerellaceae; genus__Colletotrichum; species__Colletotrichum_lagenaria";
         assert_equal(t5462.lineage(), lineage);
         assert_equal(t5462.lineage(true), lineage);
         assert_equal(t5462.lineage(false), full_lineage);
+        assert_equal(taxonomy.find(1).lineage(), string(""));
+    }
+    void test_principal() {
+        cout << "Test Node::principal(size_t)" << endl;
+        Taxonomy taxonomy;
+        build_taxonomy(taxonomy);
+        Node t5462 = taxonomy.find(5462);
+        vector<uint32_t> expected = {4751, 4890, 147550, 1028384, 681950, 5455, 5462};
+        for (size_t slot=0; slot<PRINCIPALS.size(); ++slot) {
+            assert_equal(t5462.principal(slot).taxid(), expected[slot]);
+        }
+        Node t4890 = taxonomy.find(4890);
+        assert_equal(t4890.principal(0).taxid(), uint32_t(4751));
+        assert_equal(t4890.principal(1).taxid(), uint32_t(4890));
+        assert_false(t4890.principal(2).valid());
+        assert_false(taxonomy.find(1).principal(0).valid());
+    }
+    void test_lineage_unordered() {
+        cout << "Test Node::lineage() (repeated and out-of-order principal ranks)" << endl;
+        Taxonomy taxonomy;
+        taxonomy.add(1, 1, "root", "no rank");
+        taxonomy.add(2, 1, "Genus a", "genus");
+        taxonomy.add(3, 2, "Family b", "family");
+        taxonomy.add(4, 3, "Species c", "species");
+        taxonomy.add(5, 4, "Species d", "species");
+        taxonomy.build();
+        assert_equal(taxonomy.find(4).lineage(), string("g__Genus_a; f__Family_b; s__Species_c"));
+        assert_equal(taxonomy.find(5).lineage(), string("g__Genus_a; f__Family_b; s__Species_c; s__Species_d"));
+        assert_equal(taxonomy.find(2).lineage(), string("g__Genus_a"));
     }
     void test() {
         cout << "Test Node" << endl;
         test_construct_method1();
         test_construct_method2();
-        test_append();
+        test_is_root();
+        test_child();
         test_trace();
         test_expand();
+        test_contains();
+        test_is_principal();
         test_str();
         test_lineage();
+        test_principal();
+        test_lineage_unordered();
     }
 };
 
-class TestNodeIO {
+class TestTaxonomy {
 public:
-    void test_parse1() {
-        cout << "Test NodeIO::parse(const string&, const unordered_map<string, string>&, unordered_map<string, Node*>&)" << endl;
-        unordered_map<string, string> names;
+    void test_find() {
+        cout << "Test Taxonomy::find(uint32_t)" << endl;
+        Taxonomy taxonomy;
+        build_taxonomy(taxonomy);
+        assert_equal(taxonomy.size(), size_t(18));
+        assert_equal(taxonomy.find(5455).name(), string("Colletotrichum"));
+        assert_false(taxonomy.find(5456).valid());
+        assert_false(taxonomy.find(99999999).valid());
+        assert_true(Taxonomy().empty());
+        assert_false(Taxonomy().find(1).valid());
+    }
+    void test_build_invalid() {
+        cout << "Test Taxonomy::build() (invalid)" << endl;
+        bool thrown = false;
+        Taxonomy orphan;
+        orphan.add(1, 1, "root", "no rank");
+        orphan.add(2, 3, "Bacteria", "domain");
+        try {
+            orphan.build();
+        } catch (const runtime_error&) {
+            thrown = true;
+        }
+        assert_true(thrown);
+
+        thrown = false;
+        Taxonomy cycle;
+        cycle.add(1, 1, "root", "no rank");
+        cycle.add(2, 3, "a", "clade");
+        cycle.add(3, 2, "b", "clade");
+        try {
+            cycle.build();
+        } catch (const runtime_error&) {
+            thrown = true;
+        }
+        assert_true(thrown);
+
+        thrown = false;
+        Taxonomy duplicate;
+        duplicate.add(1, 1, "root", "no rank");
+        duplicate.add(1, 1, "root", "no rank");
+        try {
+            duplicate.build();
+        } catch (const runtime_error&) {
+            thrown = true;
+        }
+        assert_true(thrown);
+    }
+    void test() {
+        cout << "Test Taxonomy" << endl;
+        test_find();
+        test_build_invalid();
+    }
+};
+
+class TestTaxonomyIO {
+public:
+    void test_save_load() {
+        cout << "Test TaxonomyIO::save(...) and TaxonomyIO::load(...)" << endl;
+        unordered_map<uint32_t, string> names;
         NameIO::parse("test-data/taxdmp/names.dmp", names);
+        Taxonomy parsed;
+        NodeIO::parse("test-data/taxdmp/nodes.dmp", names, parsed);
+        TaxonomyIO::save("test-data/taxdmp/subnx.taxonomy", "test-data/taxdmp/names.dmp", "test-data/taxdmp/nodes.dmp", parsed);
 
-        unordered_map<string, Node*> nodes;
-        NodeIO::parse("test-data/taxdmp/nodes.dmp", names, nodes);
-
-        assert_equal(nodes.size(), size_t(18));
-        Node* t1 = nodes.at("1");
-
-        // 131567
-        Node* t131567 = nodes.at("131567");
-        assert_ptr_equal(t131567->parent, t1);
-        assert_equal(t1->children.size(), size_t(1));
-        assert_ptr_equal(t1->children[0], t131567);
-
-        // 2759
-        Node* t2759 = nodes.at("2759");
-        assert_ptr_equal(t2759->parent, t131567);
-        assert_equal(t131567->children.size(), size_t(1));
-        assert_ptr_equal(t131567->children[0], t2759);
-
-        // 33154
-        Node* t33154 = nodes.at("33154");
-        assert_ptr_equal(t33154->parent, t2759);
-        assert_equal(t2759->children.size(), size_t(1));
-        assert_ptr_equal(t2759->children[0], t33154);
-
-        // 4751
-        Node* t4751 = nodes.at("4751");
-        assert_ptr_equal(t4751->parent, t33154);
-        assert_equal(t33154->children.size(), size_t(1));
-        assert_ptr_equal(t33154->children[0], t4751);
-
-        // 451864
-        Node* t451864 = nodes.at("451864");
-        assert_ptr_equal(t451864->parent, t4751);
-        assert_equal(t4751->children.size(), size_t(1));
-        assert_ptr_equal(t4751->children[0], t451864);
-
-        // 4890
-        Node* t4890 = nodes.at("4890");
-        assert_ptr_equal(t4890->parent, t451864);
-        assert_equal(t451864->children.size(), size_t(1));
-        assert_ptr_equal(t451864->children[0], t4890);
-
-        // 716545
-        Node* t716545 = nodes.at("716545");
-        assert_ptr_equal(t716545->parent, t4890);
-        assert_equal(t4890->children.size(), size_t(1));
-        assert_ptr_equal(t4890->children[0], t716545);
-
-        // 147538
-        Node* t147538 = nodes.at("147538");
-        assert_ptr_equal(t147538->parent, t716545);
-        assert_equal(t716545->children.size(), size_t(1));
-        assert_ptr_equal(t716545->children[0], t147538);
-
-        // 716546
-        Node* t716546 = nodes.at("716546");
-        assert_ptr_equal(t716546->parent, t147538);
-        assert_equal(t147538->children.size(), size_t(1));
-        assert_ptr_equal(t147538->children[0], t716546);
-
-        // 715989
-        Node* t715989 = nodes.at("715989");
-        assert_ptr_equal(t715989->parent, t716546);
-        assert_equal(t716546->children.size(), size_t(1));
-        assert_ptr_equal(t716546->children[0], t715989);
-
-        // 147550
-        Node* t147550 = nodes.at("147550");
-        assert_ptr_equal(t147550->parent, t715989);
-        assert_equal(t715989->children.size(), size_t(1));
-        assert_ptr_equal(t715989->children[0], t147550);
-
-        // t222543
-        Node* t222543 = nodes.at("222543");
-        assert_ptr_equal(t222543->parent, t147550);
-        assert_equal(t147550->children.size(), size_t(1));
-        assert_ptr_equal(t147550->children[0], t222543);
-
-        // 1028384
-        Node* t1028384 = nodes.at("1028384");
-        assert_ptr_equal(t1028384->parent, t222543);
-        assert_equal(t222543->children.size(), size_t(1));
-        assert_ptr_equal(t222543->children[0], t1028384);
-
-        // 681950
-        Node* t681950 = nodes.at("681950");
-        assert_ptr_equal(t681950->parent, t1028384);
-        assert_equal(t1028384->children.size(), size_t(1));
-        assert_ptr_equal(t1028384->children[0], t681950);
-
-        // 5455
-        Node* t5455 = nodes.at("5455");
-        assert_ptr_equal(t5455->parent, t681950);
-        assert_equal(t681950->children.size(), size_t(1));
-        assert_ptr_equal(t681950->children[0], t5455);
-
-        // 5462
-        Node* t5462 = nodes.at("5462");
-        assert_ptr_equal(t5462->parent, t5455);
-        assert_equal(t5455->children.size(), size_t(2));
-        assert_ptr_equal(t5455->children[0], t5462);
-
-        // 27358
-        Node* t27358 = nodes.at("27358");
-        assert_ptr_equal(t27358->parent, t5455);
-        assert_ptr_equal(t5455->children[1], t27358);
+        Taxonomy loaded;
+        assert_true(TaxonomyIO::load("test-data/taxdmp/subnx.taxonomy", "test-data/taxdmp/names.dmp", "test-data/taxdmp/nodes.dmp", loaded));
+        assert_equal(loaded.size(), parsed.size());
+        for (size_t i=0; i<parsed.size(); ++i) {
+            Node expected = parsed.at(i);
+            Node actual = loaded.find(expected.taxid());
+            assert_equal(actual.index(), expected.index());
+            assert_equal(actual.name(), expected.name());
+            assert_equal(actual.rank(), expected.rank());
+            assert_equal(actual.degree(), expected.degree());
+            assert_equal(actual.is_principal(), expected.is_principal());
+            assert_equal(actual.lineage(false), expected.lineage(false));
+            assert_equal(actual.lineage(true), expected.lineage(true));
+        }
+        assert_false(loaded.find(5456).valid());
     }
-    void test_parse2() {
-        cout << "Test NodeIO::parse(const string&, const unordered_map<string, string>&, unordered_map<string, Node*>&) (empty)" << endl;
-        unordered_map<string, string> names;
+    void test_load_stale() {
+        cout << "Test TaxonomyIO::load(...) (stale or missing)" << endl;
+        Taxonomy taxonomy;
+        assert_false(TaxonomyIO::load("test-data/taxdmp/subnx.taxonomy", "test-data/taxdmp/names.dmp", "test-data/taxdmp/names.dmp", taxonomy));
+        assert_false(TaxonomyIO::load("test-data/taxdmp/missing.taxonomy", "test-data/taxdmp/names.dmp", "test-data/taxdmp/nodes.dmp", taxonomy));
+        assert_false(TaxonomyIO::load("test-data/taxdmp/names.dmp", "test-data/taxdmp/names.dmp", "test-data/taxdmp/nodes.dmp", taxonomy));
+        assert_true(taxonomy.empty());
+    }
+    void test() {
+        cout << "Test TaxonomyIO" << endl;
+        test_save_load();
+        test_load_stale();
+    }
+};
+
+class TestNodeIO {
+public:
+    void test_parse1() {
+        cout << "Test NodeIO::parse(const string&, const unordered_map<uint32_t, string>&, Taxonomy&)" << endl;
+        unordered_map<uint32_t, string> names;
         NameIO::parse("test-data/taxdmp/names.dmp", names);
 
-        unordered_map<string, Node*> nodes;
-        NodeIO::parse("test-data/taxdmp/names.dmp", names, nodes);
+        Taxonomy taxonomy;
+        NodeIO::parse("test-data/taxdmp/nodes.dmp", names, taxonomy);
+        assert_equal(taxonomy.size(), size_t(18));
 
-        assert_equal(nodes.size(), size_t(0));
+        // every node but the genus has a single child, the next one in the lineage
+        for (size_t i=LINEAGE_5462.size()-1; i>0; --i) {
+            Node parent = taxonomy.find(LINEAGE_5462[i]);
+            Node node = taxonomy.find(LINEAGE_5462[i-1]);
+            assert_true(node.parent() == parent);
+            if (parent.taxid() != 5455) {
+                assert_equal(parent.degree(), size_t(1));
+            }
+            assert_true(parent.child(0) == node);
+        }
+        Node t5455 = taxonomy.find(5455);
+        Node t27358 = taxonomy.find(27358);
+        assert_true(t27358.parent() == t5455);
+        assert_equal(t5455.degree(), size_t(2));
+        assert_true(t5455.child(1) == t27358);
+        assert_equal(t5455.name(), string("Colletotrichum"));
+        assert_equal(t5455.rank(), string("genus"));
     }
-    void test_destroy() {
-        cout << "Test NodeIO::destroy()" << endl;
-        unordered_map<string, string> names;
+    void test_parse2() {
+        cout << "Test NodeIO::parse(const string&, const unordered_map<uint32_t, string>&, Taxonomy&) (empty)" << endl;
+        unordered_map<uint32_t, string> names;
         NameIO::parse("test-data/taxdmp/names.dmp", names);
 
-        unordered_map<string, Node*> nodes;
-        NodeIO::parse("test-data/taxdmp/nodes.dmp", names, nodes);
+        Taxonomy taxonomy;
+        NodeIO::parse("test-data/taxdmp/names.dmp", names, taxonomy);
 
-        assert_not_nullptr(nodes.at("1"));
-        NodeIO::destroy(nodes);
-        assert_nullptr(nodes.at("1"));
+        assert_equal(taxonomy.size(), size_t(0));
     }
     void test() {
         cout << "Test NodeIO" << endl;
         test_parse1();
         test_parse2();
-        test_destroy();
     }
 };
 
 class TestAccession2TaxIdIO {
 public:
-    void test() {
-        cout << "Test Accession2TaxIdIO" << endl;
-        unordered_map<string, string> names;
+    void test_parse() {
+        cout << "Test Accession2TaxIdIO::parse(const string&, const Taxonomy&, const vector<Node>&, AccessionTable&, unordered_map<Accession, uint32_t>&)" << endl;
+        unordered_map<uint32_t, string> names;
         NameIO::parse("test-data/taxdmp/names.dmp", names);
-        unordered_map<string, Node*> nodes;
-        NodeIO::parse("test-data/taxdmp/nodes.dmp", names, nodes);
-        Node* node = nodes.at("5455");
-        vector<const Node*> descendants;
-        node->expand(descendants);
-        unordered_set<string> taxids;
-        for (const Node* descendant : descendants) {
-            taxids.insert(descendant->id);
-        }
-        unordered_map<string, string> accession2taxid;
-        Accession2TaxIdIO::parse("test-data/nucl_gb.accession2taxid", taxids, accession2taxid);
+        Taxonomy taxonomy;
+        NodeIO::parse("test-data/taxdmp/nodes.dmp", names, taxonomy);
+        Node node = taxonomy.find(5455);
+        AccessionTable accession_table;
+        unordered_map<Accession, uint32_t> accession2taxid;
+        Accession2TaxIdIO::parse("test-data/nucl_gb.accession2taxid", taxonomy, {node}, accession_table, accession2taxid);
         assert_equal(accession2taxid.size(), size_t(2));
 
         assert_true(accession2taxid.find("HG799543") != accession2taxid.end());
-        assert_equal(accession2taxid["HG799543"], string("27358"));
+        assert_equal(accession2taxid["HG799543"], uint32_t(27358));
 
         assert_true(accession2taxid.find("ON631770") != accession2taxid.end());
-        assert_equal(accession2taxid["ON631770"], string("5462"));
+        assert_equal(accession2taxid["ON631770"], uint32_t(5462));
 
         assert_false(accession2taxid.find("X17276") != accession2taxid.end());
     }
+    void test_parse_parallel() {
+        cout << "Test Accession2TaxIdIO::parse(const string&, const Taxonomy&, const vector<Node>&, AccessionTable&, unordered_map<Accession, uint32_t>&, unsigned int)" << endl;
+        Taxonomy taxonomy;
+        build_taxonomy(taxonomy);
+        for (unsigned int threads : {1u, 2u, 3u, 16u, 1000u}) {
+            AccessionTable accession_table;
+            unordered_map<Accession, uint32_t> accession2taxid;
+            uint64_t lines = Accession2TaxIdIO::parse("test-data/nucl_gb.accession2taxid", taxonomy, {taxonomy.find(1)}, accession_table, accession2taxid, threads);
+            assert_equal(lines, uint64_t(4));
+            assert_equal(accession2taxid.size(), size_t(3));
+            assert_equal(accession2taxid.at("X17276"), uint32_t(4890));
+            assert_equal(accession2taxid.at("HG799543"), uint32_t(27358));
+            assert_equal(accession2taxid.at("ON631770"), uint32_t(5462));
+            assert_false(accession2taxid.find("AB000001") != accession2taxid.end());
+        }
+    }
+    void test_parse_multiple() {
+        cout << "Test Accession2TaxIdIO::parse(const string&, const Taxonomy&, const vector<Node>&, AccessionTable&, unordered_map<Accession, uint32_t>&) (multiple nodes)" << endl;
+        Taxonomy taxonomy;
+        build_taxonomy(taxonomy);
+        AccessionTable accession_table;
+        unordered_map<Accession, uint32_t> accession2taxid;
+        Accession2TaxIdIO::parse("test-data/nucl_gb.accession2taxid", taxonomy, {taxonomy.find(27358), taxonomy.find(5462)}, accession_table, accession2taxid);
+        assert_equal(accession2taxid.size(), size_t(2));
+        assert_equal(accession2taxid.at("HG799543"), uint32_t(27358));
+        assert_equal(accession2taxid.at("ON631770"), uint32_t(5462));
+    }
+    void test_parse_gzip() {
+        cout << "Test Accession2TaxIdIO::parse(const string&, const Taxonomy&, const vector<Node>&, AccessionTable&, unordered_map<Accession, uint32_t>&, unsigned int) (gzip)" << endl;
+        Taxonomy taxonomy;
+        build_taxonomy(taxonomy);
+        write_gzip("test-data/nucl_gb.accession2taxid.gz", read_file("test-data/nucl_gb.accession2taxid"));
+        for (unsigned int threads : {1u, 3u}) {
+            AccessionTable accession_table;
+            unordered_map<Accession, uint32_t> accession2taxid;
+            Accession2TaxIdIO::parse("test-data/nucl_gb.accession2taxid.gz", taxonomy, {taxonomy.find(1)}, accession_table, accession2taxid, threads);
+            assert_equal(accession2taxid.size(), size_t(3));
+            assert_equal(accession2taxid.at("X17276"), uint32_t(4890));
+            assert_equal(accession2taxid.at("HG799543"), uint32_t(27358));
+            assert_equal(accession2taxid.at("ON631770"), uint32_t(5462));
+        }
+    }
+    void test_parse_malformed() {
+        cout << "Test Accession2TaxIdIO::parse(const string&, const Taxonomy&, const vector<Node>&, AccessionTable&, unordered_map<Accession, uint32_t>&) (malformed lines)" << endl;
+        Taxonomy taxonomy;
+        build_taxonomy(taxonomy);
+        ofstream out("test-data/malformed.accession2taxid");
+        out << "accession\taccession.version\ttaxid\tgi\n";
+        out << "HG799543\tHG799543.1\t27358\n";
+        out << "ON631770\tON631770.1\t5462\t2260034044\textra\n";
+        out << "X17276\tX17276.1\t48x90\t2260034045\n";
+        out << "AB000001\tAB000001.1\t999999999\t2260034046\n";
+        out << "MZ000001\tMZ000001.1\t27358\t2260034047\n";
+        out.close();
+        AccessionTable accession_table;
+        unordered_map<Accession, uint32_t> accession2taxid;
+        Accession2TaxIdIO::parse("test-data/malformed.accession2taxid", taxonomy, {taxonomy.find(1)}, accession_table, accession2taxid);
+        assert_equal(accession2taxid.size(), size_t(1));
+        assert_equal(accession2taxid.at("MZ000001"), uint32_t(27358));
+    }
+    void test_parse_unpacked() {
+        cout << "Test Accession2TaxIdIO::parse(const string&, const Taxonomy&, const vector<Node>&, AccessionTable&, unordered_map<Accession, uint32_t>&, unsigned int) (unpacked accessions)" << endl;
+        Taxonomy taxonomy;
+        build_taxonomy(taxonomy);
+        ofstream out("test-data/unpacked.accession2taxid");
+        out << "accession\taccession.version\ttaxid\tgi\n";
+        out << "1ABC_A\t1ABC_A.1\t27358\t0\n";
+        out << "HG799543\tHG799543.1\t27358\t2260034043\n";
+        out << "1ABC_A\t1ABC_A.2\t5462\t0\n";
+        out << "2XYZ_B\t2XYZ_B.1\t5462\t0\n";
+        out.close();
+        for (unsigned int threads : {1u, 3u}) {
+            AccessionTable accession_table;
+            unordered_map<Accession, uint32_t> accession2taxid;
+            Accession2TaxIdIO::parse("test-data/unpacked.accession2taxid", taxonomy, {taxonomy.find(1)}, accession_table, accession2taxid, threads);
+            assert_equal(accession2taxid.size(), size_t(3));
+            assert_equal(accession_table.size(), size_t(2));
+            assert_equal(accession2taxid.at(Accession("1ABC_A", accession_table)), uint32_t(27358));
+            assert_equal(accession2taxid.at(Accession("2XYZ_B", accession_table)), uint32_t(5462));
+            assert_equal(accession_table.size(), size_t(2));
+        }
+    }
+    void test() {
+        cout << "Test Accession2TaxIdIO" << endl;
+        test_parse();
+        test_parse_unpacked();
+        test_parse_multiple();
+        test_parse_malformed();
+        test_parse_gzip();
+        test_parse_parallel();
+    }
+};
+
+class TestAccession2TaxIdTableIO {
+public:
+    void test_create() {
+        cout << "Test Accession2TaxIdTableIO::create(const string&, const string&, unsigned int)" << endl;
+        Taxonomy taxonomy;
+        build_taxonomy(taxonomy);
+        for (unsigned int threads : {1u, 3u}) {
+            Accession2TaxIdTableIO::create("test-data/nucl_gb.accession2taxid", "test-data/nucl_gb.accession2taxid.idx", threads);
+            AccessionTable accession_table;
+            unordered_map<Accession, uint32_t> accession2taxid;
+            assert_true(Accession2TaxIdTableIO::parse("test-data/nucl_gb.accession2taxid.idx", "test-data/nucl_gb.accession2taxid",
+                                                      taxonomy, {taxonomy.find(1)}, accession_table, accession2taxid));
+            assert_equal(accession2taxid.size(), size_t(3));
+            assert_equal(accession2taxid.at("X17276"), uint32_t(4890));
+            assert_equal(accession2taxid.at("HG799543"), uint32_t(27358));
+            assert_equal(accession2taxid.at("ON631770"), uint32_t(5462));
+        }
+    }
+    void test_parse() {
+        cout << "Test Accession2TaxIdTableIO::parse(const string&, const string&, const Taxonomy&, const vector<Node>&, AccessionTable&, unordered_map<Accession, uint32_t>&)" << endl;
+        Taxonomy taxonomy;
+        build_taxonomy(taxonomy);
+        AccessionTable accession_table;
+        unordered_map<Accession, uint32_t> accession2taxid;
+        assert_true(Accession2TaxIdTableIO::parse("test-data/nucl_gb.accession2taxid.idx", "test-data/nucl_gb.accession2taxid",
+                                                  taxonomy, {taxonomy.find(5455)}, accession_table, accession2taxid));
+        assert_equal(accession2taxid.size(), size_t(2));
+        assert_equal(accession2taxid.at("HG799543"), uint32_t(27358));
+        assert_equal(accession2taxid.at("ON631770"), uint32_t(5462));
+
+        accession2taxid.clear();
+        assert_true(Accession2TaxIdTableIO::parse("test-data/nucl_gb.accession2taxid.idx", "test-data/nucl_gb.accession2taxid",
+                                                  taxonomy, {taxonomy.find(4890), taxonomy.find(5462)}, accession_table, accession2taxid));
+        assert_equal(accession2taxid.size(), size_t(3));
+
+        // built from another file, or missing
+        assert_false(Accession2TaxIdTableIO::parse("test-data/nucl_gb.accession2taxid.idx", "test-data/taxdmp/names.dmp",
+                                                   taxonomy, {taxonomy.find(1)}, accession_table, accession2taxid));
+        assert_false(Accession2TaxIdTableIO::parse("test-data/missing.idx", "test-data/nucl_gb.accession2taxid",
+                                                   taxonomy, {taxonomy.find(1)}, accession_table, accession2taxid));
+    }
+    void test() {
+        cout << "Test Accession2TaxIdTableIO" << endl;
+        test_create();
+        test_parse();
+    }
 };
 
 class TestIndexIO {
 public:
     void compare_index(const Index& index1, const Index& index2) {
-        assert_equal(index1.accession, index2.accession);
+        assert_equal(index1.accession.str(), index2.accession.str());
         assert_equal(index1.accession_version, index2.accession_version);
         assert_equal(index1.pos, index2.pos);
         assert_equal(index1.length, index2.length);
@@ -495,7 +917,7 @@ public:
         cout << "Test IndexIO::create(const string&, const string&)" << endl;
         IndexIO::create("test-data/nt", "test-data/nt.fai");
         vector<Index> actual_indexes;
-        unordered_set<string> accessions = {"X17276", "HG799543", "ON631770"};
+        unordered_set<Accession> accessions = {"X17276", "HG799543", "ON631770"};
         IndexIO::parse("test-data/nt.fai", accessions, actual_indexes);
         vector<Index> expected_indexes = {
             Index("X17276", "X17276.1", 0, 601),
@@ -506,10 +928,19 @@ public:
         compare_index(actual_indexes[1], expected_indexes[1]);
         compare_index(actual_indexes[2], expected_indexes[2]);
     }
+    void test_create_parallel() {
+        cout << "Test IndexIO::create(const string&, const string&, unsigned int)" << endl;
+        IndexIO::create("test-data/nt", "test-data/nt.fai", 1);
+        string expected = read_file("test-data/nt.fai");
+        for (unsigned int threads : {2u, 3u, 7u, 64u}) {
+            IndexIO::create("test-data/nt", "test-data/nt.fai", threads);
+            assert_equal(read_file("test-data/nt.fai"), expected);
+        }
+    }
     void test_parse() {
-        cout << "Test IndexIO::parse(const string&, const unordered_set<string>&, vector<Index>&)" << endl;
+        cout << "Test IndexIO::parse(const string&, const unordered_set<Accession>&, vector<Index>&)" << endl;
         vector<Index> actual_indexes;
-        unordered_set<string> accessions = {"HG799543", "ON631770"};
+        unordered_set<Accession> accessions = {"HG799543", "ON631770"};
         IndexIO::parse("test-data/nt.fai", accessions, actual_indexes);
         vector<Index> expected_indexes = {
             Index("HG799543", "HG799543.1", 601, 396),
@@ -522,22 +953,692 @@ public:
     void test() {
         cout << "Test IndexIO" << endl;
         test_create();
+        test_create_parallel();
+        test_parse();
+    }
+};
+
+class TestBinaryIndexIO {
+public:
+    void compare_index(const Index& index1, const Index& index2) {
+        assert_equal(index1.accession.str(), index2.accession.str());
+        assert_equal(index1.accession_version, index2.accession_version);
+        assert_equal(index1.pos, index2.pos);
+        assert_equal(index1.length, index2.length);
+    }
+    void test_create() {
+        cout << "Test BinaryIndexIO::create(const string&, const string&, unsigned int)" << endl;
+        BinaryIndexIO::create("test-data/nt", "test-data/nt.idx", 2);
+        vector<Index> actual_indexes;
+        unordered_set<Accession> accessions = {"ON631770", "X17276", "HG799543", "AB000001"};
+        BinaryIndexIO::parse("test-data/nt.idx", accessions, actual_indexes);
+        vector<Index> expected_indexes = {
+            Index("X17276", "X17276.1", 0, 601),
+            Index("HG799543", "HG799543.1", 601, 396),
+            Index("ON631770", "ON631770.1", 997, 797)
+        };
+        assert_equal(actual_indexes.size(), size_t(3));
+        compare_index(actual_indexes[0], expected_indexes[0]);
+        compare_index(actual_indexes[1], expected_indexes[1]);
+        compare_index(actual_indexes[2], expected_indexes[2]);
+    }
+    void test_convert() {
+        cout << "Test BinaryIndexIO::convert(const string&, const string&, const string&)" << endl;
+        IndexIO::create("test-data/nt", "test-data/nt.fai");
+        BinaryIndexIO::convert("test-data/nt.fai", "test-data/nt.converted.idx", "test-data/nt");
+        assert_equal(read_file("test-data/nt.converted.idx"), read_file("test-data/nt.idx"));
+    }
+    void test_dump() {
+        cout << "Test BinaryIndexIO::dump(const string&, const string&)" << endl;
+        BinaryIndexIO::dump("test-data/nt.idx", "test-data/nt.dumped.fai");
+        assert_equal(read_file("test-data/nt.dumped.fai"), read_file("test-data/nt.fai"));
+    }
+    void test_parse() {
+        cout << "Test BinaryIndexIO::parse(const string&, const unordered_set<Accession>&, vector<Index>&)" << endl;
+        vector<Index> actual_indexes;
+        unordered_set<Accession> accessions = {"ON631770", "HG799543"};
+        BinaryIndexIO::parse("test-data/nt.idx", accessions, actual_indexes);
+        assert_equal(actual_indexes.size(), size_t(2));
+        compare_index(actual_indexes[0], Index("HG799543", "HG799543.1", 601, 396));
+        compare_index(actual_indexes[1], Index("ON631770", "ON631770.1", 997, 797));
+
+        actual_indexes.clear();
+        AccessionTable table;
+        BinaryIndexIO::parse("test-data/nt.idx", unordered_set<Accession>{Accession("X1727", table), Accession("X172760", table)}, actual_indexes);
+        assert_equal(actual_indexes.size(), size_t(0));
+
+        // accessions that do not pack are matched by name
+        ofstream out("test-data/odd.fa");
+        out << ">1ABC_A.1 structure\nACGT\n>AB000001.1 other\nACGT\n>2XYZ_B.1 another\nACGT\n";
+        out.close();
+        BinaryIndexIO::create("test-data/odd.fa", "test-data/odd.fa.idx");
+        actual_indexes.clear();
+        BinaryIndexIO::parse("test-data/odd.fa.idx", unordered_set<Accession>{Accession("1ABC_A", table), "AB000001"}, actual_indexes);
+        assert_equal(actual_indexes.size(), size_t(2));
+        assert_equal(actual_indexes[0].accession_version, string("1ABC_A.1"));
+        assert_true(actual_indexes[0].accession == Accession("1ABC_A", table));
+        assert_equal(actual_indexes[1].accession_version, string("AB000001.1"));
+    }
+    void test_create_gzip() {
+        cout << "Test BinaryIndexIO::create(const string&, const string&, unsigned int) (gzip)" << endl;
+        write_gzip("test-data/nt.gz", read_file("test-data/nt"));
+        BinaryIndexIO::create("test-data/nt.gz", "test-data/nt.gz.idx");
+        BinaryIndexIO::dump("test-data/nt.gz.idx", "test-data/nt.gz.dumped.fai");
+        assert_equal(read_file("test-data/nt.gz.dumped.fai"), read_file("test-data/nt.fai"));
+        IndexIO::create("test-data/nt.gz", "test-data/nt.gz.fai");
+        assert_equal(read_file("test-data/nt.gz.fai"), read_file("test-data/nt.fai"));
+
+        write_bgzf("test-data/nt.bgz", read_file("test-data/nt"), 256);
+        BinaryIndexIO::create("test-data/nt.bgz", "test-data/nt.bgz.idx");
+        BinaryIndexIO::dump("test-data/nt.bgz.idx", "test-data/nt.bgz.dumped.fai");
+        assert_equal(read_file("test-data/nt.bgz.dumped.fai"), read_file("test-data/nt.fai"));
+        assert_true(os::path::exists("test-data/nt.bgz.gzi"));
+    }
+    void test_append() {
+        cout << "Test BinaryIndexIO::append(const string&, const string&, unsigned int)" << endl;
+        string nt = read_file("test-data/nt");
+        ofstream out("test-data/nt.grown", ios::binary);
+        out << nt.substr(0, 997);  // X17276.1 and HG799543.1
+        out.close();
+        BinaryIndexIO::create("test-data/nt.grown", "test-data/nt.grown.idx");
+        assert_equal(BinaryIndexIO::check("test-data/nt.grown", "test-data/nt.grown.idx"), BinaryIndexIO::CURRENT);
+
+        // the last record grows and a new one follows
+        out.open("test-data/nt.grown", ios::binary | ios::app);
+        out << "ACGT\n" << nt.substr(997) << ">AB000001.1 appended\nACGT\n";
+        out.close();
+        assert_equal(BinaryIndexIO::check("test-data/nt.grown", "test-data/nt.grown.idx"), BinaryIndexIO::APPENDED);
+        for (unsigned int threads : {1u, 3u}) {
+            BinaryIndexIO::append("test-data/nt.grown", "test-data/nt.grown.idx", threads);
+            assert_equal(BinaryIndexIO::check("test-data/nt.grown", "test-data/nt.grown.idx"), BinaryIndexIO::CURRENT);
+            BinaryIndexIO::create("test-data/nt.grown", "test-data/nt.rebuilt.idx", threads);
+            BinaryIndexIO::dump("test-data/nt.grown.idx", "test-data/nt.grown.fai");
+            BinaryIndexIO::dump("test-data/nt.rebuilt.idx", "test-data/nt.rebuilt.fai");
+            assert_equal(read_file("test-data/nt.grown.fai"), read_file("test-data/nt.rebuilt.fai"));
+        }
+        vector<Index> indexes;
+        BinaryIndexIO::parse("test-data/nt.grown.idx", unordered_set<Accession>{"HG799543", "AB000001"}, indexes);
+        assert_equal(indexes.size(), size_t(2));
+        compare_index(indexes[0], Index("HG799543", "HG799543.1", 601, 401));
+        compare_index(indexes[1], Index("AB000001", "AB000001.1", 1799, 26));
+
+        // replaced content is indexed again from scratch
+        out.open("test-data/nt.grown", ios::binary);
+        out << nt.substr(601);
+        out.close();
+        assert_equal(BinaryIndexIO::check("test-data/nt.grown", "test-data/nt.grown.idx"), BinaryIndexIO::STALE);
+        assert_equal(BinaryIndexIO::check("test-data/nt.grown", "test-data/missing.idx"), BinaryIndexIO::STALE);
+        assert_equal(BinaryIndexIO::check("test-data/nt.grown", "test-data/nt.fai"), BinaryIndexIO::STALE);
+        assert_equal(BinaryIndexIO::check("test-data/nt.gz", "test-data/nt.gz.idx"), BinaryIndexIO::CURRENT);
+    }
+    void test_aliases() {
+        cout << "Test BinaryIndexIO::create(const string&, const string&, unsigned int) (aliases)" << endl;
+        string nr = ">WP_000001.1 protein A [Species A]\x01WP_000002.1 protein A [Species B]\x01XP_000003.1 protein A\n"
+                    "MKVLAAGIVG\n"
+                    ">WP_000004.1 protein B [Species A]\n"
+                    "MAT\n";
+        ofstream out("test-data/nr", ios::binary);
+        out << nr;
+        out.close();
+        write_gzip("test-data/nr.gz", nr);
+        string expected = "WP_000001\tWP_000001.1\t0\t102\n"
+                          "WP_000002\tWP_000002.1\t0\t102\n"
+                          "XP_000003\tXP_000003.1\t0\t102\n"
+                          "WP_000004\tWP_000004.1\t102\t39\n";
+        for (const char* file : {"test-data/nr", "test-data/nr.gz"}) {
+            for (unsigned int threads : {1u, 3u}) {
+                BinaryIndexIO::create(file, "test-data/nr.idx", threads);
+                BinaryIndexIO::dump("test-data/nr.idx", "test-data/nr.fai");
+                assert_equal(read_file("test-data/nr.fai"), expected);
+                IndexIO::create(file, "test-data/nr.fai", threads);
+                assert_equal(read_file("test-data/nr.fai"), expected);
+            }
+        }
+
+        // the accessions of a header share one record
+        BinaryIndexIO::create("test-data/nr", "test-data/nr.idx");
+        assert_equal(read_file("test-data/nr.idx").size(), size_t(64 + 2 * 16 + 4 * 24 + 11 * 4));
+        BinaryIndexIO::convert("test-data/nr.fai", "test-data/nr.converted.idx", "test-data/nr");
+        assert_equal(read_file("test-data/nr.converted.idx"), read_file("test-data/nr.idx"));
+
+        vector<Index> indexes;
+        BinaryIndexIO::parse("test-data/nr.idx", unordered_set<Accession>{"XP_000003", "WP_000002", "WP_000004"}, indexes);
+        assert_equal(indexes.size(), size_t(3));
+        compare_index(indexes[0], Index("WP_000002", "WP_000002.1", 0, 102));
+        compare_index(indexes[1], Index("XP_000003", "XP_000003.1", 0, 102));
+        compare_index(indexes[2], Index("WP_000004", "WP_000004.1", 102, 39));
+
+        // appended records keep the aliases of the old ones
+        out.open("test-data/nr", ios::binary | ios::app);
+        out << ">WP_000005.1 protein C\x01WP_000006.1 protein C\nMG\n";
+        out.close();
+        BinaryIndexIO::append("test-data/nr", "test-data/nr.idx");
+        BinaryIndexIO::dump("test-data/nr.idx", "test-data/nr.fai");
+        assert_equal(read_file("test-data/nr.fai"), expected + "WP_000005\tWP_000005.1\t141\t48\n"
+                                                             + "WP_000006\tWP_000006.1\t141\t48\n");
+    }
+    void test_invalid() {
+        cout << "Test BinaryIndexIO::parse(const string&, const unordered_set<Accession>&, vector<Index>&) (invalid)" << endl;
+        vector<Index> indexes;
+        bool thrown = false;
+        try {
+            BinaryIndexIO::parse("test-data/nt.fai", unordered_set<Accession>{"X17276"}, indexes);
+        } catch (const runtime_error&) {
+            thrown = true;
+        }
+        assert_true(thrown);
+    }
+    void test() {
+        cout << "Test BinaryIndexIO" << endl;
+        test_create();
+        test_convert();
+        test_dump();
+        test_parse();
+        test_create_gzip();
+        test_append();
+        test_aliases();
+        test_invalid();
+    }
+};
+
+class TestDescriptionIO {
+public:
+    vector<Index> all_indexes() {
+        return {
+            Index("X17276", "X17276.1", 0, 601),
+            Index("HG799543", "HG799543.1", 601, 396),
+            Index("ON631770", "ON631770.1", 997, 797)
+        };
+    }
+    // accession versions of the records kept, comma-separated
+    string filter(const string& file, const string& source_file, const string& spec) {
+        vector<Index> indexes = all_indexes();
+        assert_true(DescriptionIO::filter(file, source_file, HeaderFilter(spec), indexes));
+        string versions;
+        for (const Index& index : indexes) {
+            versions += (versions.empty() ? "" : ",") + index.accession_version;
+        }
+        return versions;
+    }
+    void test_header_filter() {
+        cout << "Test HeaderFilter::keeps(const char*, size_t)" << endl;
+        string description = "Colletotrichum coccodes ITS";
+        assert_true(HeaderFilter().empty());
+        assert_true(HeaderFilter().keeps(description.data(), description.size()));
+        assert_true(HeaderFilter("coccodes").keeps(description.data(), description.size()));
+        assert_true(! HeaderFilter("!coccodes").keeps(description.data(), description.size()));
+        assert_true(! HeaderFilter("ITS$").keeps(description.data(), description.size()));
+        assert_true(HeaderFilter("/ITS$/").keeps(description.data(), description.size()));
+        assert_true(! HeaderFilter("!/^Colletotrichum/").keeps(description.data(), description.size()));
+        assert_true(HeaderFilter("/").keeps("a/b", 3));
+        bool thrown = false;
+        try {
+            HeaderFilter("/(ITS/");
+        } catch (const runtime_error&) {
+            thrown = true;
+        }
+        assert_true(thrown);
+    }
+    void test_filter() {
+        cout << "Test DescriptionIO::filter(const string&, const string&, const HeaderFilter&, vector<Index>&)" << endl;
+        DescriptionIO::create("test-data/nt", "test-data/nt.desc", 2);
+        assert_equal(filter("test-data/nt.desc", "test-data/nt", "Colletotrichum"), string("HG799543.1,ON631770.1"));
+        assert_equal(filter("test-data/nt.desc", "test-data/nt", "!Colletotrichum"), string("X17276.1"));
+        assert_equal(filter("test-data/nt.desc", "test-data/nt", "/(18|28)S/"), string("X17276.1,ON631770.1"));
+        assert_equal(filter("test-data/nt.desc", "test-data/nt", "!/ITS|rRNA/"), string("ON631770.1"));
+
+        write_gzip("test-data/nt.desc.gz", read_file("test-data/nt"));
+        DescriptionIO::create("test-data/nt.desc.gz", "test-data/nt.gz.desc");
+        assert_equal(filter("test-data/nt.gz.desc", "test-data/nt.desc.gz", "!/ITS|rRNA/"), string("ON631770.1"));
+
+        // built from another file
+        vector<Index> indexes = all_indexes();
+        assert_true(! DescriptionIO::filter("test-data/nt.desc", "test-data/nt.desc.gz", HeaderFilter("ITS"), indexes));
+        assert_true(! DescriptionIO::filter("test-data/nt.fai", "test-data/nt", HeaderFilter("ITS"), indexes));
+        assert_true(! DescriptionIO::filter("test-data/missing.desc", "test-data/nt", HeaderFilter("ITS"), indexes));
+        assert_equal(indexes.size(), size_t(3));
+    }
+    void test() {
+        cout << "Test DescriptionIO" << endl;
+        test_header_filter();
+        test_filter();
+    }
+};
+
+class TestDatabaseIO {
+public:
+    void test_parse() {
+        cout << "Test DatabaseIO::parse(const string&, const string&, const string&, const string&, const string&, const Taxonomy&, const vector<Node>&, AccessionTable&, unordered_map<Accession, uint32_t>&, vector<Index>&)" << endl;
+        Taxonomy taxonomy;
+        build_taxonomy(taxonomy);
+        BinaryIndexIO::create("test-data/nt", "test-data/nt.idx");
+        DatabaseIO::create("test-data/nt.db", "test-data/taxdmp/names.dmp", "test-data/taxdmp/nodes.dmp",
+                           "test-data/nucl_gb.accession2taxid", "test-data/nt", "test-data/nt.idx", taxonomy, 2);
+
+        AccessionTable accession_table;
+        unordered_map<Accession, uint32_t> accession2taxid;
+        vector<Index> indexes;
+        assert_true(DatabaseIO::parse("test-data/nt.db", "test-data/taxdmp/names.dmp", "test-data/taxdmp/nodes.dmp",
+                                      "test-data/nucl_gb.accession2taxid", "test-data/nt", taxonomy,
+                                      {taxonomy.find(5455), taxonomy.find(5462)}, accession_table, accession2taxid, indexes));
+        assert_equal(indexes.size(), size_t(2));
+        assert_equal(indexes[0].accession.str(), string("HG799543"));
+        assert_equal(indexes[0].accession_version, string("HG799543.1"));
+        assert_equal(indexes[0].pos, size_t(601));
+        assert_equal(indexes[0].length, size_t(396));
+        assert_equal(indexes[1].accession_version, string("ON631770.1"));
+        assert_equal(indexes[1].pos, size_t(997));
+        assert_equal(accession2taxid.size(), size_t(2));
+        assert_equal(accession2taxid.at("HG799543"), uint32_t(27358));
+        assert_equal(accession2taxid.at("ON631770"), uint32_t(5462));
+
+        accession2taxid.clear();
+        indexes.clear();
+        assert_true(DatabaseIO::parse("test-data/nt.db", "test-data/taxdmp/names.dmp", "test-data/taxdmp/nodes.dmp",
+                                      "test-data/nucl_gb.accession2taxid", "test-data/nt", taxonomy,
+                                      {taxonomy.find(1)}, accession_table, accession2taxid, indexes));
+        assert_equal(indexes.size(), size_t(3));
+        assert_equal(indexes[0].accession_version, string("X17276.1"));
+        assert_equal(accession2taxid.at("X17276"), uint32_t(4890));
+    }
+    void test_stale() {
+        cout << "Test DatabaseIO::parse(const string&, const string&, const string&, const string&, const string&, const Taxonomy&, const vector<Node>&, AccessionTable&, unordered_map<Accession, uint32_t>&, vector<Index>&) (stale)" << endl;
+        Taxonomy taxonomy;
+        build_taxonomy(taxonomy);
+        AccessionTable accession_table;
+        unordered_map<Accession, uint32_t> accession2taxid;
+        vector<Index> indexes;
+        assert_false(DatabaseIO::parse("test-data/nt.db", "test-data/taxdmp/names.dmp", "test-data/taxdmp/nodes.dmp",
+                                       "test-data/nucl_gb.accession2taxid", "test-data/nt.fai", taxonomy,
+                                       {taxonomy.find(1)}, accession_table, accession2taxid, indexes));
+        assert_false(DatabaseIO::parse("test-data/missing.db", "test-data/taxdmp/names.dmp", "test-data/taxdmp/nodes.dmp",
+                                       "test-data/nucl_gb.accession2taxid", "test-data/nt", taxonomy,
+                                       {taxonomy.find(1)}, accession_table, accession2taxid, indexes));
+        assert_equal(indexes.size(), size_t(0));
+    }
+    void test() {
+        cout << "Test DatabaseIO" << endl;
         test_parse();
+        test_stale();
+    }
+};
+
+class TestTargetIO {
+public:
+    void test_parse() {
+        cout << "Test TargetIO::parse(const string&, vector<Target>&)" << endl;
+        ofstream out("test-data/batch.tsv");
+        out << "# taxid\ttaxa\tseqs\n"
+            << "5455\t5455.taxa.txt\t5455.fa\n"
+            << "\n"
+            << "4751\t4751.taxa.txt\n";
+        out.close();
+        vector<Target> targets;
+        TargetIO::parse("test-data/batch.tsv", targets);
+        assert_equal(targets.size(), size_t(2));
+        assert_equal(targets[0].id, string("5455"));
+        assert_equal(targets[0].taxa_file, string("5455.taxa.txt"));
+        assert_equal(targets[0].seqs_file, string("5455.fa"));
+        assert_equal(targets[1].id, string("4751"));
+        assert_equal(targets[1].taxa_file, string("4751.taxa.txt"));
+        assert_equal(targets[1].seqs_file, string(""));
+    }
+    void test_invalid() {
+        cout << "Test TargetIO::parse(const string&, vector<Target>&) (invalid)" << endl;
+        ofstream out("test-data/batch.tsv");
+        out << "5455\n";
+        out.close();
+        vector<Target> targets;
+        bool thrown = false;
+        try {
+            TargetIO::parse("test-data/batch.tsv", targets);
+        } catch (const runtime_error&) {
+            thrown = true;
+        }
+        assert_true(thrown);
+    }
+    void test() {
+        cout << "Test TargetIO" << endl;
+        test_parse();
+        test_invalid();
+    }
+};
+
+class TestResultIO {
+public:
+    void test_write_seqs() {
+        cout << "Test ResultIO::write_seqs(const string&, const vector<Index>&, const vector<vector<size_t>>&, const vector<string>&, unsigned int)" << endl;
+        vector<Index> indexes = {
+            Index("X17276", "X17276.1", 0, 601),
+            Index("HG799543", "HG799543.1", 601, 396),
+            Index("ON631770", "ON631770.1", 997, 797)
+        };
+        ResultIO::write_seqs("test-data/nt", indexes, "test-data/all.fa");
+        string nt = read_file("test-data/nt");
+        assert_equal(read_file("test-data/all.fa"), nt);
+
+        vector<vector<size_t>> selections = {{0, 2}, {1, 2}, {}};
+        ResultIO::write_seqs("test-data/nt", indexes, selections, {"test-data/a.fa", "test-data/b.fa", "test-data/c.fa"});
+        assert_equal(read_file("test-data/a.fa"), nt.substr(0, 601) + nt.substr(997, 797));
+        assert_equal(read_file("test-data/b.fa"), nt.substr(601, 396 + 797));
+        assert_equal(read_file("test-data/c.fa"), string(""));
+
+        for (unsigned int threads : {2u, 3u, 16u}) {
+            ResultIO::write_seqs("test-data/nt", indexes, selections, {"test-data/a.fa", "test-data/b.fa", "test-data/c.fa"}, threads);
+            assert_equal(read_file("test-data/a.fa"), nt.substr(0, 601) + nt.substr(997, 797));
+            assert_equal(read_file("test-data/b.fa"), nt.substr(601, 396 + 797));
+            assert_equal(read_file("test-data/c.fa"), string(""));
+        }
+
+        // two accessions of one record
+        vector<Index> aliases = {indexes[0], Index("X17277", "X17277.1", 0, 601), indexes[2]};
+        ResultIO::write_seqs("test-data/nt", aliases, {{0, 1, 2}, {1}}, {"test-data/a.fa", "test-data/b.fa"}, 2);
+        assert_equal(read_file("test-data/a.fa"), nt.substr(0, 601) + nt.substr(997, 797));
+        assert_equal(read_file("test-data/b.fa"), nt.substr(0, 601));
+
+        vector<Index> unordered = {indexes[2], indexes[0], indexes[1]};
+        ResultIO::write_seqs("test-data/nt", unordered, {{0, 1}, {0, 2}}, {"test-data/a.fa", "test-data/b.fa"});
+        assert_equal(read_file("test-data/a.fa"), nt.substr(0, 601) + nt.substr(997, 797));
+        assert_equal(read_file("test-data/b.fa"), nt.substr(601, 396 + 797));
+
+        write_bgzf("test-data/nt.bgz", nt, 256);
+        ResultIO::write_seqs("test-data/nt.bgz", indexes, selections, {"test-data/a.fa", "test-data/b.fa", "test-data/c.fa"});
+        assert_equal(read_file("test-data/a.fa"), nt.substr(0, 601) + nt.substr(997, 797));
+        assert_equal(read_file("test-data/b.fa"), nt.substr(601, 396 + 797));
+        assert_equal(read_file("test-data/c.fa"), string(""));
+
+        write_gzip("test-data/nt.gz", nt);
+        ResultIO::write_seqs("test-data/nt.gz", indexes, selections, {"test-data/a.fa", "test-data/b.fa", "test-data/c.fa"});
+        assert_equal(read_file("test-data/a.fa"), nt.substr(0, 601) + nt.substr(997, 797));
+        assert_equal(read_file("test-data/b.fa"), nt.substr(601, 396 + 797));
+        assert_equal(read_file("test-data/c.fa"), string(""));
+
+        // the stream ends before the last record
+        write_gzip("test-data/nt.truncated.gz", nt.substr(0, 1200));
+        bool thrown = false;
+        try {
+            ResultIO::write_seqs("test-data/nt.truncated.gz", indexes, selections, {"test-data/a.fa", "test-data/b.fa", "test-data/c.fa"});
+        } catch (const runtime_error&) {
+            thrown = true;
+        }
+        assert_true(thrown);
+    }
+    void test_write_seqs_dedup() {
+        cout << "Test ResultIO::write_seqs(const string&, const vector<Index>&, const vector<vector<size_t>>&, const vector<string>&, vector<vector<size_t>>&)" << endl;
+        vector<string> records = {
+            ">AB000001.1 first\nACGT\nACG\n",
+            ">AB000002.1 same sequence, other width\nACGTACG\n",
+            ">AB000003.1 other\nACGTACC\n",
+            ">AB000004.1 same again\r\nACG\r\nTACG\r\n"
+        };
+        vector<Index> indexes;
+        string dup;
+        for (size_t i=0; i<records.size(); ++i) {
+            string accession = records[i].substr(1, 8);
+            indexes.emplace_back(accession, accession + ".1", dup.size(), records[i].size());
+            dup += records[i];
+        }
+        ofstream out("test-data/dup.fa", ios::binary);
+        out << dup;
+        out.close();
+        write_gzip("test-data/dup.fa.gz", dup);
+        write_bgzf("test-data/dup.fa.bgz", dup, 16);
+        for (const char* file : {"test-data/dup.fa", "test-data/dup.fa.gz", "test-data/dup.fa.bgz"}) {
+            vector<vector<size_t>> representatives;
+            ResultIO::write_seqs(file, indexes, {{3, 2, 1, 0}, {3, 2}, {}}, {"test-data/a.fa", "test-data/b.fa", "test-data/c.fa"}, representatives);
+            assert_equal(read_file("test-data/a.fa"), records[0] + records[2]);
+            assert_equal(read_file("test-data/b.fa"), records[2] + records[3]);
+            assert_equal(read_file("test-data/c.fa"), string(""));
+            assert_equal(representatives.size(), size_t(3));
+            assert_true(representatives[0] == vector<size_t>({0, 2, 0, 0}));
+            assert_true(representatives[1] == vector<size_t>({3, 2}));
+            assert_true(representatives[2].empty());
+        }
+
+        // records larger than the 4 MiB copy buffer, the second one wrapped at another width
+        string sequence;
+        for (size_t i=0; i<(5 << 20); ++i) {
+            sequence += "ACGT"[(i * 7 + i / 13) % 4];
+        }
+        vector<string> long_records = {">AB000005.1 long\n", ">AB000006.1 long again\n", ">AB000007.1 long other\n"};
+        for (size_t i=0; i<sequence.size(); i+=80) {
+            long_records[0] += sequence.substr(i, 80) + "\n";
+        }
+        for (size_t i=0; i<sequence.size(); i+=60) {
+            long_records[1] += sequence.substr(i, 60) + "\n";
+        }
+        long_records[2] += sequence.substr(1) + "A\n";
+        vector<Index> long_indexes;
+        string long_dup;
+        for (size_t i=0; i<long_records.size(); ++i) {
+            string accession = long_records[i].substr(1, 8);
+            long_indexes.emplace_back(accession, accession + ".1", long_dup.size(), long_records[i].size());
+            long_dup += long_records[i];
+        }
+        out.open("test-data/long.fa", ios::binary);
+        out << long_dup;
+        out.close();
+        write_gzip("test-data/long.fa.gz", long_dup);
+        write_bgzf("test-data/long.fa.bgz", long_dup, 65280);
+        for (const char* file : {"test-data/long.fa", "test-data/long.fa.gz", "test-data/long.fa.bgz"}) {
+            vector<vector<size_t>> representatives;
+            ResultIO::write_seqs(file, long_indexes, {{0, 1, 2}, {2, 1}}, {"test-data/a.fa", "test-data/b.fa"}, representatives, 2);
+            assert_true(read_file("test-data/a.fa") == long_records[0] + long_records[2]);
+            assert_true(read_file("test-data/b.fa") == long_records[1] + long_records[2]);
+            assert_true(representatives[0] == vector<size_t>({0, 0, 2}));
+            assert_true(representatives[1] == vector<size_t>({2, 1}));
+        }
+
+        Taxonomy taxonomy;
+        build_taxonomy(taxonomy);
+        unordered_map<Accession, uint32_t> accession2taxid = {{"AB000001", 27358}, {"AB000003", 5462}, {"AB000004", 27358}};
+        ResultIO::write_taxa(indexes, {3, 2, 0}, {0, 2, 0}, accession2taxid, taxonomy, false, "test-data/dup.taxa.txt");
+        istringstream taxa(read_file("test-data/dup.taxa.txt"));
+        string line;
+        vector<string> expected = {"AB000004.1\t", "AB000001.1", "AB000003.1\t", "AB000003.1", "AB000001.1\t", "AB000001.1"};
+        for (size_t i=0; i<expected.size(); i+=2) {
+            assert_true(static_cast<bool>(getline(taxa, line)));
+            assert_equal(line.substr(0, 11), expected[i]);
+            assert_equal(line.substr(line.rfind('\t') + 1), expected[i+1]);
+        }
+    }
+    void test_select() {
+        cout << "Test ResultIO::select(const vector<Index>&, const unordered_map<Accession, uint32_t>&, const Taxonomy&, const Node&, vector<size_t>&)" << endl;
+        Taxonomy taxonomy;
+        build_taxonomy(taxonomy);
+        vector<Index> indexes = {
+            Index("X17276", "X17276.1", 0, 601),
+            Index("HG799543", "HG799543.1", 601, 396),
+            Index("ON631770", "ON631770.1", 997, 797)
+        };
+        unordered_map<Accession, uint32_t> accession2taxid = {{"X17276", 4890}, {"HG799543", 27358}, {"ON631770", 5462}};
+        vector<size_t> selection;
+        ResultIO::select(indexes, accession2taxid, taxonomy, taxonomy.find(5455), selection);
+        assert_equal(selection.size(), size_t(2));
+        assert_equal(selection[0], size_t(1));
+        assert_equal(selection[1], size_t(2));
+    }
+    void test() {
+        cout << "Test ResultIO" << endl;
+        test_write_seqs();
+        test_write_seqs_dedup();
+        test_select();
+    }
+};
+
+class TestMetricsIO {
+public:
+    void test_write() {
+        cout << "Test MetricsIO::write(const string&, const Metrics&, const string&, unsigned int)" << endl;
+        Metrics metrics;
+        metrics.start("stale");
+        metrics.cancel();
+        metrics.start("sequences");
+        ResultIO::write_seqs("test-data/nt", {Index("X17276", "X17276.1", 0, 601)}, "test-data/metrics.fa");
+        metrics.stop({"test-data/nt"}, {"test-data/metrics.fa", "test-data/missing.fa"}, 3, 1);
+        metrics.start("taxonomy");
+        metrics.stop({}, {}, -1, 18);
+        assert_equal(metrics.stages().size(), size_t(2));
+        assert_equal(metrics.stages()[0].name, string("sequences"));
+        assert_equal(metrics.stages()[0].input_bytes, uint64_t(1794));
+        assert_equal(metrics.stages()[0].output_bytes, uint64_t(601));
+
+        MetricsIO::write("test-data/metrics.json", metrics, "subnx -n \"nt\"", 2);
+        string json = read_file("test-data/metrics.json");
+        assert_true(json.find("\"command\": \"subnx -n \\\"nt\\\"\"") != string::npos);
+        assert_true(json.find("\"threads\": 2,") != string::npos);
+        assert_true(json.find("{\"name\": \"sequences\", \"seconds\": ") != string::npos);
+        assert_true(json.find("\"input_bytes\": 1794, \"output_bytes\": 601") != string::npos);
+        assert_true(json.find("\"records_scanned\": 3, \"records_matched\": 1") != string::npos);
+        assert_true(json.find("\"records_scanned\": null, \"records_matched\": 18") != string::npos);
+        assert_false(json.find("stale") != string::npos);
+    }
+    void test() {
+        cout << "Test MetricsIO" << endl;
+        test_write();
+    }
+};
+
+class TestRequestIO {
+public:
+    void test_format() {
+        cout << "Test RequestIO::format(const Request&)" << endl;
+        assert_equal(RequestIO::format(Request("5455", "/a/5455.txt", "", true)), string("5455\t/a/5455.txt\t\t1\t0\t1\t\n"));
+        Request request("5455", "/a/5455.txt", "/a/5455.fa", false);
+        request.dedup = true;
+        request.threads = 4;
+        request.header_filter = "!/ITS|rRNA/";
+        assert_equal(RequestIO::format(request), string("5455\t/a/5455.txt\t/a/5455.fa\t0\t1\t4\t!/ITS|rRNA/\n"));
+    }
+    void test_parse() {
+        cout << "Test RequestIO::parse(const string&, Request&)" << endl;
+        Request request;
+        assert_true(RequestIO::parse("5455\t/a/5455.txt\t/a/5455.fa\t0\t1\t4\tITS", request));
+        assert_equal(request.id, string("5455"));
+        assert_equal(request.taxa_file, string("/a/5455.txt"));
+        assert_equal(request.seqs_file, string("/a/5455.fa"));
+        assert_false(request.full_lineage);
+        assert_true(request.dedup);
+        assert_equal(request.threads, 4u);
+        assert_equal(request.header_filter, string("ITS"));
+        assert_false(RequestIO::parse("5455\t/a/5455.txt\t\t2\t0\t1\t", request));
+        assert_false(RequestIO::parse("5455\t/a/5455.txt\t\t1\t0\t0\t", request));
+        assert_false(RequestIO::parse("5455\t/a/5455.txt\t\t1", request));
+        assert_false(RequestIO::parse("5455\t/a/5455.txt", request));
+        assert_false(RequestIO::parse("\t/a/5455.txt\t\t1\t0\t1\t", request));
+    }
+    void test() {
+        cout << "Test RequestIO" << endl;
+        test_format();
+        test_parse();
+    }
+};
+
+class TestServer {
+public:
+    void test_serve() {
+        cout << "Test Server::serve()" << endl;
+        Taxonomy taxonomy;
+        build_taxonomy(taxonomy);
+        BinaryIndexIO::create("test-data/nt", "test-data/nt.idx");
+        DatabaseIO::create("test-data/nt.db", "test-data/taxdmp/names.dmp", "test-data/taxdmp/nodes.dmp",
+                           "test-data/nucl_gb.accession2taxid", "test-data/nt", "test-data/nt.idx", taxonomy);
+        Database database;
+        assert_true(database.load("test-data/nt.db", "test-data/taxdmp/names.dmp", "test-data/taxdmp/nodes.dmp",
+                                  "test-data/nucl_gb.accession2taxid", "test-data/nt", taxonomy));
+        Server server(taxonomy, database, "test-data/nt", 2);
+        server.listen("test-data/subnx.sock");
+        thread serving([&]() { server.serve(); });
+
+        assert_equal(Client::request("test-data/subnx.sock", Request("5455", "test-data/served.txt", "test-data/served.fa", false)), size_t(2));
+        string nt = read_file("test-data/nt");
+        assert_equal(read_file("test-data/served.fa"), nt.substr(601));
+        assert_equal(Client::request("test-data/subnx.sock", Request("1", "test-data/served.txt", "", true)), size_t(3));
+
+        bool thrown = false;
+        try {
+            Client::request("test-data/subnx.sock", Request("999999", "test-data/served.txt", "", false));
+        } catch (const runtime_error& exc) {
+            thrown = true;
+            assert_equal(string(exc.what()), string("999999: Taxon ID not found"));
+        }
+        assert_true(thrown);
+
+        // the same options as a local run
+        Request request("5455", "test-data/served.txt", "test-data/served.fa", false);
+        request.header_filter = "!ITS";
+        request.dedup = true;
+        request.threads = 4;
+        assert_equal(Client::request("test-data/subnx.sock", request), size_t(1));
+        assert_equal(read_file("test-data/served.fa"), nt.substr(997));
+        assert_true(os::path::exists("test-data/nt.desc"));
+
+        // output paths are taken only as given
+        os::Socket connection = os::Socket::connect("test-data/subnx.sock");
+        for (const string& line : {string("5455\tserved.txt\t\t0\t0\t1\t\n"),
+                                   os::path::absolute("test-data") + "/../served.txt\t\t0\t0\t1\t\n"}) {
+            connection.write(line.substr(0, 5) == "5455\t" ? line : "5455\t" + line);
+            string reply;
+            assert_true(connection.read_line(reply));
+            assert_equal(reply.substr(0, 6), string("ERROR\t"));
+        }
+        assert_equal(os::path::absolute("a/./b/../c"), os::path::absolute("a/c"));
+
+        // an idle client does not keep the server running
+        server.stop();
+        serving.join();
+        assert_false(os::path::exists("test-data/subnx.sock"));
+    }
+    void test() {
+        cout << "Test Server" << endl;
+        test_serve();
     }
 };
 
 int main() {
     try {
+        TestFields test_fields{};
+        test_fields.test();
+        TestGzipReader test_gzip_reader{};
+        test_gzip_reader.test();
+        TestAtomicFile test_atomic_file{};
+        test_atomic_file.test();
+        TestBgzfFile test_bgzf_file{};
+        test_bgzf_file.test();
+        TestAccession test_accession{};
+        test_accession.test();
         TestNameIO test_name_io{};
         test_name_io.test();
         TestNode test_node{};
         test_node.test();
+        TestTaxonomy test_taxonomy{};
+        test_taxonomy.test();
         TestNodeIO test_node_io{};
         test_node_io.test();
+        TestTaxonomyIO test_taxonomy_io{};
+        test_taxonomy_io.test();
         TestAccession2TaxIdIO test_accession2taxid{};
         test_accession2taxid.test();
+        TestAccession2TaxIdTableIO test_accession2taxid_table_io{};
+        test_accession2taxid_table_io.test();
         TestIndexIO test_index_io{};
         test_index_io.test();
+        TestBinaryIndexIO test_binary_index_io{};
+        test_binary_index_io.test();
+        TestDescriptionIO test_description_io{};
+        test_description_io.test();
+        TestDatabaseIO test_database_io{};
+        test_database_io.test();
+        TestTargetIO test_target_io{};
+        test_target_io.test();
+        TestResultIO test_result_io{};
+        test_result_io.test();
+        TestMetricsIO test_metrics_io{};
+        test_metrics_io.test();
+        TestRequestIO test_request_io{};
+        test_request_io.test();
+        TestServer test_server{};
+        test_server.test();
     } catch (const exception& exc) {
         cerr << exc.what() << endl;
     }
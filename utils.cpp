@@ -2,8 +2,19 @@
 #include <random>
 #include <cstring>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdexcept>
 #include <algorithm>
 #include <iostream>
+#include <fstream>
+#include <zlib.h>
 
 void str::split(const std::string& str, char sep, std::vector<std::string>& substrs) {
     std::string::size_type i = 0;
@@ -97,6 +108,39 @@ std::string str::random(std::size_t n) {
     return str;
 }
 
+str::View::View() : data(nullptr), size(0) {}
+
+str::View::View(const char* data, std::size_t size) : data(data), size(size) {}
+
+std::string str::View::str() const {
+    return std::string(data, size);
+}
+
+bool str::View::startswith(const char* prefix) const {
+    std::size_t n = strlen(prefix);
+    return (n <= size) && (memcmp(data, prefix, n) == 0);
+}
+
+bool str::View::operator==(const char* other) const {
+    return (strlen(other) == size) && (memcmp(data, other, size) == 0);
+}
+
+bool str::View::operator!=(const char* other) const {
+    return ! (*this == other);
+}
+
+bool str::to_uint(const View& view, std::uint64_t& value) {
+    if (view.size == 0) return false;
+    value = 0;
+    for (std::size_t i=0; i<view.size; ++i) {
+        unsigned char c = view.data[i] - '0';
+        if (c > 9) return false;
+        if (value > (UINT64_MAX - c) / 10) return false;  // would overflow
+        value = value * 10 + c;
+    }
+    return true;
+}
+
 bool os::path::exists(const std::string &path) {
     struct stat buffer;
     return (stat(path.c_str(), &buffer) == 0);
@@ -117,3 +161,927 @@ std::string os::path::join(std::initializer_list<std::string> paths) {
     }
     return result;
 }
+
+std::uint64_t os::path::size(const std::string& path) {
+    struct stat buffer;
+    if (stat(path.c_str(), &buffer) != 0) {
+        throw std::runtime_error(path + ": No such file or directory");
+    }
+    return buffer.st_size;
+}
+
+std::int64_t os::path::mtime(const std::string& path) {
+    struct stat buffer;
+    if (stat(path.c_str(), &buffer) != 0) {
+        throw std::runtime_error(path + ": No such file or directory");
+    }
+    return std::int64_t(buffer.st_mtim.tv_sec) * 1000000000 + buffer.st_mtim.tv_nsec;
+}
+
+std::uint64_t os::path::fingerprint(const std::string& path) {
+    return fingerprint(path, os::path::size(path));
+}
+
+std::uint64_t os::path::fingerprint(const std::string& path, std::uint64_t size) {
+    // FNV-1a over the size and up to three 64 KiB samples (head, middle, tail) of the first size bytes
+    static const std::size_t SAMPLE = 1 << 16;
+    std::uint64_t hash = 14695981039346656037ULL;
+    auto update = [&hash](const char* data, std::size_t n) {
+        for (std::size_t i=0; i<n; ++i) {
+            hash ^= static_cast<unsigned char>(data[i]);
+            hash *= 1099511628211ULL;
+        }
+    };
+    update(reinterpret_cast<const char*>(&size), sizeof(size));
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error(path + ": Failed to open file");
+    }
+    std::vector<char> buffer(SAMPLE);
+    std::uint64_t offsets[3] = {0, size / 2, (size > SAMPLE) ? size - SAMPLE : 0};
+    for (std::uint64_t offset : offsets) {
+        ssize_t n = pread(fd, buffer.data(), std::min<std::uint64_t>(SAMPLE, size - offset), offset);
+        if (n < 0) {
+            ::close(fd);
+            throw std::runtime_error(path + ": Failed to read file");
+        }
+        update(buffer.data(), n);
+    }
+    ::close(fd);
+    return hash;
+}
+
+os::MappedFile::MappedFile() : data_(nullptr), size_(0) {}
+
+os::MappedFile::MappedFile(const std::string& path) : data_(nullptr), size_(0) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error(path + ": Failed to open file");
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error(path + ": Failed to stat file");
+    }
+    size_ = st.st_size;
+    if (size_ > 0) {  // mmap does not accept zero length
+        void* addr = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error(path + ": Failed to map file");
+        }
+        data_ = static_cast<char*>(addr);
+    }
+    ::close(fd);
+}
+
+os::MappedFile::MappedFile(MappedFile&& other) : data_(other.data_), size_(other.size_) {
+    other.data_ = nullptr;
+    other.size_ = 0;
+}
+
+os::MappedFile& os::MappedFile::operator=(MappedFile&& other) {
+    if (this != &other) {
+        close();
+        data_ = other.data_;
+        size_ = other.size_;
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+    return *this;
+}
+
+os::MappedFile::~MappedFile() {
+    close();
+}
+
+const char* os::MappedFile::data() const {
+    return data_;
+}
+
+std::size_t os::MappedFile::size() const {
+    return size_;
+}
+
+void os::MappedFile::advise_sequential() const {
+    if (data_ != nullptr) {
+        madvise(data_, size_, MADV_SEQUENTIAL);
+    }
+}
+
+void os::MappedFile::close() {
+    if (data_ != nullptr) {
+        munmap(data_, size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+}
+
+os::File::File() : fd_(-1) {}
+
+os::File::File(const std::string& path, Mode mode) : path_(path), fd_(-1) {
+    fd_ = (mode == READ) ? ::open(path.c_str(), O_RDONLY) : ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
+        throw std::runtime_error(path + ": Failed to open file");
+    }
+}
+
+os::File::File(File&& other) : path_(std::move(other.path_)), fd_(other.fd_) {
+    other.fd_ = -1;
+}
+
+os::File& os::File::operator=(File&& other) {
+    if (this != &other) {
+        close();
+        path_ = std::move(other.path_);
+        fd_ = other.fd_;
+        other.fd_ = -1;
+    }
+    return *this;
+}
+
+os::File::~File() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+int os::File::fd() const {
+    return fd_;
+}
+
+const std::string& os::File::path() const {
+    return path_;
+}
+
+void os::File::pread(char* buffer, std::size_t n, std::uint64_t offset) const {
+    while (n > 0) {
+        ssize_t got = ::pread(fd_, buffer, n, offset);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) {
+            throw std::runtime_error(path_ + ": Failed to read file");
+        }
+        buffer += got;
+        n -= got;
+        offset += got;
+    }
+}
+
+void os::File::write(const char* data, std::size_t n) {
+    while (n > 0) {
+        ssize_t put = ::write(fd_, data, n);
+        if (put < 0 && errno == EINTR) continue;
+        if (put <= 0) {
+            throw std::runtime_error(path_ + ": Failed to write file");
+        }
+        data += put;
+        n -= put;
+    }
+}
+
+bool os::File::copy_from(const File& in, std::uint64_t offset, std::uint64_t length) {
+    bool started = false;
+    bool use_sendfile = false;
+    while (length > 0) {
+        ssize_t n;
+        if (use_sendfile) {
+            off_t pos = offset;
+            n = ::sendfile(fd_, in.fd_, &pos, length);
+        } else {
+            loff_t pos = offset;
+            n = ::copy_file_range(in.fd_, &pos, fd_, nullptr, length, 0);
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if ((n < 0) && (! started)
+            && ((errno == EXDEV) || (errno == EINVAL) || (errno == ENOSYS) || (errno == EOPNOTSUPP) || (errno == EBADF))) {
+            if (use_sendfile) return false;
+            use_sendfile = true;  // e.g. across file systems on older kernels
+            continue;
+        }
+        if (n < 0) {
+            throw std::runtime_error(path_ + ": Failed to write file");
+        }
+        if (n == 0) {
+            throw std::runtime_error(in.path_ + ": Failed to read file");
+        }
+        started = true;
+        offset += n;
+        length -= n;
+    }
+    return true;
+}
+
+bool os::File::copy_from(const File& in, std::uint64_t offset, std::uint64_t length, std::uint64_t out_offset) {
+    bool started = false;
+    while (length > 0) {
+        loff_t pos = offset;
+        loff_t out_pos = out_offset;
+        ssize_t n = ::copy_file_range(in.fd_, &pos, fd_, &out_pos, length, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if ((n < 0) && (! started)
+            && ((errno == EXDEV) || (errno == EINVAL) || (errno == ENOSYS) || (errno == EOPNOTSUPP) || (errno == EBADF))) {
+            return false;
+        }
+        if (n < 0) {
+            throw std::runtime_error(path_ + ": Failed to write file");
+        }
+        if (n == 0) {
+            throw std::runtime_error(in.path_ + ": Failed to read file");
+        }
+        started = true;
+        offset += n;
+        out_offset += n;
+        length -= n;
+    }
+    return true;
+}
+
+void os::File::pwrite(const char* data, std::size_t n, std::uint64_t offset) const {
+    while (n > 0) {
+        ssize_t put = ::pwrite(fd_, data, n, offset);
+        if (put < 0 && errno == EINTR) continue;
+        if (put <= 0) {
+            throw std::runtime_error(path_ + ": Failed to write file");
+        }
+        data += put;
+        n -= put;
+        offset += put;
+    }
+}
+
+bool os::File::allocate(std::uint64_t size) {
+    struct stat st;
+    if ((fstat(fd_, &st) != 0) || (! S_ISREG(st.st_mode))) {
+        return false;
+    }
+    if ((size > 0) && (::fallocate(fd_, 0, 0, size) != 0) && (::ftruncate(fd_, size) != 0)) {
+        throw std::runtime_error(path_ + ": Failed to allocate file");
+    }
+    return true;
+}
+
+void os::File::close() {
+    if (fd_ >= 0) {
+        if (::close(fd_) != 0) {
+            fd_ = -1;
+            throw std::runtime_error(path_ + ": Failed to write file");
+        }
+        fd_ = -1;
+    }
+}
+
+// The temporary file sits next to path so the rename stays on one file system and is atomic.
+// Its data is flushed before the rename, otherwise a crash could leave path renamed over an
+// empty or partial file; the directory is flushed after it so the new name itself persists.
+os::AtomicFile::AtomicFile(const std::string& path)
+    : path_(path), tmp_path_(path + "." + str::random(8)), out_(tmp_path_, std::ios::binary) {
+    if (! out_) {
+        throw std::runtime_error(tmp_path_ + ": Failed to open file");
+    }
+}
+
+os::AtomicFile::~AtomicFile() {
+    if (out_.is_open()) {  // not committed
+        out_.close();
+        std::remove(tmp_path_.c_str());
+    }
+}
+
+const std::string& os::AtomicFile::path() const {
+    return path_;
+}
+
+std::ofstream& os::AtomicFile::stream() {
+    return out_;
+}
+
+void os::AtomicFile::commit() {
+    out_.close();
+    bool written = static_cast<bool>(out_);
+    if (written) {
+        int fd = ::open(tmp_path_.c_str(), O_RDONLY);
+        written = (fd >= 0) && (fsync(fd) == 0);
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+    if ((! written) || (std::rename(tmp_path_.c_str(), path_.c_str()) != 0)) {
+        std::remove(tmp_path_.c_str());
+        throw std::runtime_error(path_ + ": Failed to write file");
+    }
+    std::size_t sep = path_.rfind(path::SEP);
+    std::string dir = (sep == std::string::npos) ? "." : ((sep == 0) ? "/" : path_.substr(0, sep));
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd >= 0) {  // best effort, the file is in place already
+        fsync(fd);
+        ::close(fd);
+    }
+}
+
+bool os::path::is_gzip(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    unsigned char magic[2] = {0, 0};
+    in.read(reinterpret_cast<char*>(magic), 2);
+    return in && (magic[0] == 0x1f) && (magic[1] == 0x8b);
+}
+
+bool os::path::is_bgzf(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    unsigned char header[16] = {0};
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    return in && (header[0] == 0x1f) && (header[1] == 0x8b) && (header[3] & 0x04)
+           && (header[12] == 'B') && (header[13] == 'C') && (header[14] == 2) && (header[15] == 0);
+}
+
+std::string os::path::absolute(const std::string& path) {
+    if (path.empty()) {
+        return path;
+    }
+    std::string full = path;
+    if (path[0] != UNIX_SEP) {
+        char cwd[4096];
+        if (getcwd(cwd, sizeof(cwd)) == nullptr) {
+            throw std::runtime_error(path + ": Failed to resolve path");
+        }
+        full = join({cwd, path});
+    }
+    std::vector<std::string> parts;
+    for (std::size_t begin=0; begin<=full.size(); ) {
+        std::size_t end = full.find(UNIX_SEP, begin);
+        if (end == std::string::npos) {
+            end = full.size();
+        }
+        std::string part = full.substr(begin, end - begin);
+        if (part == "..") {
+            if (! parts.empty()) parts.pop_back();
+        } else if ((! part.empty()) && (part != ".")) {
+            parts.push_back(part);
+        }
+        begin = end + 1;
+    }
+    std::string result;
+    for (const std::string& part : parts) {
+        result += UNIX_SEP + part;
+    }
+    return result.empty() ? std::string(1, UNIX_SEP) : result;
+}
+
+namespace {
+    // 读取 /proc 下 "key: value" 格式文件中的数值
+    std::uint64_t proc_value(const char* file, const std::string& key) {
+        std::ifstream in(file);
+        std::string line;
+        while (std::getline(in, line)) {
+            if (str::startswith(line, key)) {
+                return std::strtoull(line.c_str() + key.size(), nullptr, 10);
+            }
+        }
+        return 0;
+    }
+}
+
+std::uint64_t os::peak_rss() {
+    return proc_value("/proc/self/status", "VmHWM:") * 1024;
+}
+
+void os::reset_peak_rss() {
+    std::ofstream out("/proc/self/clear_refs");
+    out << "5";
+}
+
+std::uint64_t os::io_read_bytes() {
+    return proc_value("/proc/self/io", "read_bytes:");
+}
+
+std::uint64_t os::io_write_bytes() {
+    return proc_value("/proc/self/io", "write_bytes:");
+}
+
+os::GzipReader::GzipReader(const std::string& path, std::size_t block_size, std::size_t capacity)
+    : path_(path)
+    , block_size_(block_size)
+    , capacity_(std::max<std::size_t>(1, capacity))
+    , offset_(0)
+    , done_(false)
+    , stopped_(false) {
+    worker_ = std::thread(&GzipReader::run, this);
+}
+
+os::GzipReader::~GzipReader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+    }
+    not_full_.notify_all();
+    worker_.join();
+}
+
+std::uint64_t os::GzipReader::tell() const {
+    return offset_;
+}
+
+bool os::GzipReader::next(std::string& block) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this]() { return (! queue_.empty()) || done_; });
+    if (queue_.empty()) {
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+        return false;
+    }
+    block.swap(queue_.front());
+    queue_.pop_front();
+    offset_ = offsets_.front();
+    offsets_.pop_front();
+    lock.unlock();
+    not_full_.notify_one();
+    return true;
+}
+
+void os::GzipReader::run() {
+    try {
+        gzFile in = gzopen(path_.c_str(), "rb");
+        if (in == nullptr) {
+            throw std::runtime_error(path_ + ": Failed to open file");
+        }
+        gzbuffer(in, 1 << 18);
+        while (true) {
+            std::string block(block_size_, '\0');
+            int n = gzread(in, &block[0], block_size_);
+            if (n < 0) {
+                gzclose(in);
+                throw std::runtime_error(path_ + ": Failed to decompress file");
+            }
+            if (n == 0) {
+                int status = Z_OK;
+                gzerror(in, &status);
+                gzclose(in);
+                if (status != Z_OK) {  // truncated stream
+                    throw std::runtime_error(path_ + ": Failed to decompress file");
+                }
+                in = nullptr;
+                break;
+            }
+            block.resize(n);
+            std::uint64_t offset = gzoffset(in);
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_full_.wait(lock, [this]() { return (queue_.size() < capacity_) || stopped_; });
+            if (stopped_) break;
+            queue_.push_back(std::move(block));
+            offsets_.push_back(offset);
+            lock.unlock();
+            not_empty_.notify_one();
+        }
+        if (in != nullptr) {
+            gzclose(in);
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        error_ = std::current_exception();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_ = true;
+    }
+    not_empty_.notify_all();
+}
+
+namespace {
+    const std::size_t BGZF_HEADER_SIZE = 18;
+    const std::size_t BGZF_MAX_BLOCK_SIZE = 1 << 16;
+    const char GZI_STAMP_MAGIC[8] = {'S', 'U', 'B', 'N', 'X', 'G', 'Z', 'I'};  // trails the .gzi, stamping its BGZF file
+
+    std::uint64_t read_le(const unsigned char* p, std::size_t n) {
+        std::uint64_t value = 0;
+        for (std::size_t i=n; i>0; --i) {
+            value = (value << 8) | p[i-1];
+        }
+        return value;
+    }
+
+    void write_le(std::ostream& out, std::uint64_t value) {
+        char bytes[8];
+        for (std::size_t i=0; i<8; ++i) {
+            bytes[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+        }
+        out.write(bytes, 8);
+    }
+
+    bool pread_full(int fd, void* buffer, std::size_t n, std::uint64_t offset) {
+        char* p = static_cast<char*>(buffer);
+        while (n > 0) {
+            ssize_t got = ::pread(fd, p, n, offset);
+            if (got <= 0) return false;
+            p += got;
+            n -= got;
+            offset += got;
+        }
+        return true;
+    }
+}
+
+os::BgzfFile::BgzfFile(const std::string& path, std::size_t cache_size)
+    : path_(path), fd_(-1), cache_size_(std::max<std::size_t>(1, cache_size)) {
+    if (! load(path + ".gzi", path, blocks_)) {  // missing or stale, scan again and write it back if possible
+        scan(path, blocks_);
+        try {
+            save(path + ".gzi", path, blocks_);
+        } catch (const std::exception&) {
+        }
+    }
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        throw std::runtime_error(path + ": Failed to open file");
+    }
+}
+
+os::BgzfFile::~BgzfFile() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+void os::BgzfFile::read(std::uint64_t pos, std::size_t length, std::string& out) {
+    // the block holding pos is the last one starting at or before it
+    auto it = std::upper_bound(blocks_.begin(), blocks_.end(), pos, [](std::uint64_t value, const Block& block) {
+        return value < block.uoffset;
+    });
+    if (it == blocks_.begin()) {
+        throw std::runtime_error(path_ + ": Invalid BGZF offset");
+    }
+    std::size_t block = (it - blocks_.begin()) - 1;
+    std::uint64_t offset = pos - blocks_[block].uoffset;
+    while (length > 0) {
+        if (block >= blocks_.size()) {
+            throw std::runtime_error(path_ + ": Unexpected end of BGZF file");
+        }
+        const std::string& data = inflate(block);
+        if (offset < data.size()) {
+            std::size_t n = std::min<std::uint64_t>(length, data.size() - offset);
+            out.append(data, offset, n);
+            length -= n;
+        }
+        offset = 0;
+        ++block;
+    }
+}
+
+const std::string& os::BgzfFile::inflate(std::size_t block) {
+    auto cached = cached_.find(block);
+    if (cached != cached_.end()) {
+        cache_.splice(cache_.begin(), cache_, cached->second);
+        return cached->second->second;
+    }
+
+    unsigned char header[BGZF_HEADER_SIZE];
+    if (! pread_full(fd_, header, sizeof(header), blocks_[block].coffset)) {
+        throw std::runtime_error(path_ + ": Failed to read BGZF block");
+    }
+    std::size_t size = read_le(header + 16, 2) + 1;
+    compressed_.resize(size);
+    if ((size < BGZF_HEADER_SIZE + 8) || (! pread_full(fd_, &compressed_[0], size, blocks_[block].coffset))) {
+        throw std::runtime_error(path_ + ": Failed to read BGZF block");
+    }
+
+    // reuse the least recently used slot
+    if (cache_.size() == cache_size_) {
+        cached_.erase(cache_.back().first);
+        cache_.splice(cache_.begin(), cache_, std::prev(cache_.end()));
+    } else {
+        cache_.emplace_front();
+    }
+    std::pair<std::size_t, std::string>& slot = cache_.front();
+    slot.first = block;
+    slot.second.resize(BGZF_MAX_BLOCK_SIZE);
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.next_in = reinterpret_cast<Bytef*>(&compressed_[0]);
+    stream.avail_in = size;
+    stream.next_out = reinterpret_cast<Bytef*>(&slot.second[0]);
+    stream.avail_out = slot.second.size();
+    int status = inflateInit2(&stream, 31);  // gzip member, checks the CRC
+    if (status == Z_OK) {
+        status = ::inflate(&stream, Z_FINISH);
+        inflateEnd(&stream);
+    }
+    if (status != Z_STREAM_END) {
+        cache_.pop_front();
+        throw std::runtime_error(path_ + ": Failed to decompress BGZF block");
+    }
+    slot.second.resize(stream.total_out);
+    cached_[block] = cache_.begin();
+    return slot.second;
+}
+
+void os::BgzfFile::scan(const std::string& path, std::vector<Block>& blocks) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error(path + ": Failed to open file");
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error(path + ": Failed to stat file");
+    }
+    blocks.clear();
+    Block block = {0, 0};
+    unsigned char header[BGZF_HEADER_SIZE];
+    unsigned char trailer[4];
+    while (block.coffset < static_cast<std::uint64_t>(st.st_size)) {
+        bool valid = pread_full(fd, header, sizeof(header), block.coffset)
+                     && (header[0] == 0x1f) && (header[1] == 0x8b) && (header[12] == 'B') && (header[13] == 'C');
+        std::uint64_t size = valid ? read_le(header + 16, 2) + 1 : 0;
+        if ((! valid) || (! pread_full(fd, trailer, sizeof(trailer), block.coffset + size - 4))) {
+            ::close(fd);
+            throw std::runtime_error(path + ": Invalid BGZF file");
+        }
+        blocks.push_back(block);
+        block.coffset += size;
+        block.uoffset += read_le(trailer, 4);  // ISIZE
+    }
+    ::close(fd);
+}
+
+bool os::BgzfFile::load(const std::string& file, const std::string& path, std::vector<Block>& blocks) {
+    std::ifstream in(file, std::ios::binary);
+    if (! in) {
+        return false;
+    }
+    unsigned char bytes[24];
+    if (! in.read(reinterpret_cast<char*>(bytes), 8)) {
+        return false;
+    }
+    std::uint64_t n = read_le(bytes, 8);
+    std::vector<Block> result(1, Block{0, 0});  // the first block is implicit
+    for (std::uint64_t i=0; i<n; ++i) {
+        if (! in.read(reinterpret_cast<char*>(bytes), 16)) {
+            return false;
+        }
+        result.push_back(Block{read_le(bytes, 8), read_le(bytes + 8, 8)});
+    }
+
+    // match path: by size and mtime if stamped, otherwise (made by bgzip) the .gzi must not be older
+    if (in.read(reinterpret_cast<char*>(bytes), 24) && (memcmp(bytes, GZI_STAMP_MAGIC, 8) == 0)) {
+        if ((read_le(bytes + 8, 8) != path::size(path))
+            || (static_cast<std::int64_t>(read_le(bytes + 16, 8)) != path::mtime(path))) {
+            return false;
+        }
+    } else if (path::mtime(file) < path::mtime(path)) {
+        return false;
+    }
+
+    // the last block must start inside the file with a BGZF header
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    unsigned char header[BGZF_HEADER_SIZE];
+    bool valid = (result.back().coffset < path::size(path))
+                 && pread_full(fd, header, sizeof(header), result.back().coffset)
+                 && (header[0] == 0x1f) && (header[1] == 0x8b) && (header[12] == 'B') && (header[13] == 'C');
+    ::close(fd);
+    if (! valid) {
+        return false;
+    }
+    blocks.swap(result);
+    return true;
+}
+
+void os::BgzfFile::save(const std::string& file, const std::string& path, const std::vector<Block>& blocks) {
+    AtomicFile atomic(file);
+    std::ofstream& out = atomic.stream();
+    write_le(out, blocks.empty() ? 0 : blocks.size() - 1);
+    for (std::size_t i=1; i<blocks.size(); ++i) {
+        write_le(out, blocks[i].coffset);
+        write_le(out, blocks[i].uoffset);
+    }
+    out.write(GZI_STAMP_MAGIC, sizeof(GZI_STAMP_MAGIC));
+    write_le(out, path::size(path));
+    write_le(out, static_cast<std::uint64_t>(path::mtime(path)));
+    atomic.commit();
+}
+
+namespace {
+    std::atomic<bool> progress_enabled(false);
+
+    std::string format_bytes(double bytes) {
+        const char* units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+        std::size_t unit = 0;
+        while ((bytes >= 1024) && (unit < 4)) {
+            bytes /= 1024;
+            ++unit;
+        }
+        char text[32];
+        snprintf(text, sizeof(text), "%.1f %s", bytes, units[unit]);
+        return text;
+    }
+
+    std::string format_seconds(double seconds) {
+        std::uint64_t s = static_cast<std::uint64_t>(seconds);
+        char text[32];
+        snprintf(text, sizeof(text), "%02llu:%02llu:%02llu", static_cast<unsigned long long>(s / 3600),
+                 static_cast<unsigned long long>(s / 60 % 60), static_cast<unsigned long long>(s % 60));
+        return text;
+    }
+}
+
+os::Progress::Progress(const std::string& label, std::uint64_t total, double interval)
+    : label_(label)
+    , total_(total)
+    , interval_(interval)
+    , done_(0)
+    , start_(std::chrono::steady_clock::now())
+    , reported_(false)
+    , stopped_(false) {
+    if (enabled()) {
+        worker_ = std::thread(&Progress::run, this);
+    }
+}
+
+os::Progress::~Progress() {
+    if (! worker_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+    }
+    wakeup_.notify_all();
+    worker_.join();
+    if (reported_) {
+        report(true);
+    }
+}
+
+void os::Progress::add(std::uint64_t bytes) {
+    done_ += bytes;
+}
+
+void os::Progress::set(std::uint64_t done) {
+    done_ = done;
+}
+
+void os::Progress::enable(bool enabled) {
+    progress_enabled = enabled;
+}
+
+bool os::Progress::enabled() {
+    return progress_enabled;
+}
+
+void os::Progress::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (! wakeup_.wait_for(lock, std::chrono::duration<double>(interval_), [this]() { return stopped_; })) {
+        report(false);
+        reported_ = true;
+    }
+}
+
+void os::Progress::report(bool last) {
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    std::uint64_t done = last ? std::max<std::uint64_t>(done_, total_) : std::min<std::uint64_t>(done_, total_);
+    double rate = (seconds > 0) ? done / seconds : 0;
+    std::string line = "\r" + label_ + ": " + format_bytes(done) + " / " + format_bytes(total_);
+    if (total_ > 0) {
+        char percent[16];
+        snprintf(percent, sizeof(percent), " (%.1f%%)", 100.0 * done / total_);
+        line += percent;
+    }
+    line += ", " + format_bytes(rate) + "/s";
+    if (last) {
+        line += ", done in " + format_seconds(seconds) + "\033[K\n";
+    } else {
+        line += ", ETA " + ((rate > 0) ? format_seconds((total_ - done) / rate) : std::string("--:--:--")) + "\033[K";
+    }
+    fputs(line.c_str(), stderr);
+    fflush(stderr);
+}
+
+namespace {
+    sockaddr_un socket_address(const std::string& path) {
+        sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.empty() || (path.size() >= sizeof(address.sun_path))) {
+            throw std::runtime_error(path + ": Invalid socket path");
+        }
+        memcpy(address.sun_path, path.data(), path.size());
+        return address;
+    }
+}
+
+os::Socket::Socket() : fd_(-1) {}
+
+os::Socket::Socket(int fd) : fd_(fd) {}
+
+os::Socket::Socket(Socket&& other) : fd_(other.fd_), buffer_(std::move(other.buffer_)) {
+    other.fd_ = -1;
+}
+
+os::Socket& os::Socket::operator=(Socket&& other) {
+    if (this != &other) {
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+        fd_ = other.fd_;
+        buffer_ = std::move(other.buffer_);
+        other.fd_ = -1;
+    }
+    return *this;
+}
+
+os::Socket::~Socket() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+os::Socket os::Socket::listen(const std::string& path, int backlog) {
+    sockaddr_un address = socket_address(path);
+    struct stat st;
+    if (::lstat(path.c_str(), &st) == 0) {
+        if (! S_ISSOCK(st.st_mode)) {
+            throw std::runtime_error(path + ": File exists and is not a socket");
+        }
+        ::unlink(path.c_str());
+    }
+    Socket socket(::socket(AF_UNIX, SOCK_STREAM, 0));
+    // 套接字文件在 bind 时按 umask 创建，只允许当前用户连接
+    mode_t mask = ::umask(0177);
+    bool bound = (socket.fd_ >= 0) && (::bind(socket.fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+    ::umask(mask);
+    if ((! bound) || (::listen(socket.fd_, backlog) != 0)) {
+        throw std::runtime_error(path + ": Failed to listen on socket");
+    }
+    return socket;
+}
+
+os::Socket os::Socket::connect(const std::string& path) {
+    sockaddr_un address = socket_address(path);
+    Socket socket(::socket(AF_UNIX, SOCK_STREAM, 0));
+    if ((socket.fd_ < 0) || (::connect(socket.fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)) {
+        throw std::runtime_error(path + ": Failed to connect to socket");
+    }
+    return socket;
+}
+
+os::Socket os::Socket::accept() const {
+    while (true) {
+        int fd = ::accept(fd_, nullptr, nullptr);
+        if (fd >= 0) {
+            return Socket(fd);
+        }
+        if ((errno != EINTR) && (errno != ECONNABORTED)) {
+            return Socket();
+        }
+    }
+}
+
+bool os::Socket::valid() const {
+    return fd_ >= 0;
+}
+
+bool os::Socket::read_line(std::string& line) {
+    std::size_t pos = buffer_.find('\n');
+    char chunk[4096];
+    while (pos == std::string::npos) {
+        ssize_t n = ::read(fd_, chunk, sizeof(chunk));
+        if ((n < 0) && (errno == EINTR)) continue;
+        if (n < 0) {
+            throw std::runtime_error("Failed to read from socket");
+        }
+        if (n == 0) {
+            if (buffer_.empty()) {
+                return false;
+            }
+            line.swap(buffer_);
+            buffer_.clear();
+            return true;
+        }
+        std::size_t size = buffer_.size();
+        buffer_.append(chunk, n);
+        pos = buffer_.find('\n', size);
+    }
+    line.assign(buffer_, 0, pos);
+    buffer_.erase(0, pos + 1);
+    return true;
+}
+
+void os::Socket::write(const std::string& data) const {
+    std::size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = ::send(fd_, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+        if ((n < 0) && (errno == EINTR)) continue;
+        if (n <= 0) {
+            throw std::runtime_error("Failed to write to socket");
+        }
+        written += n;
+    }
+}
+
+void os::Socket::shutdown() const {
+    if (fd_ >= 0) {
+        ::shutdown(fd_, SHUT_RDWR);
+    }
+}
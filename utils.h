@@ -3,6 +3,18 @@
 #define UTILS_UTILS_H
 #include <vector>
 #include <string>
+#include <cstring>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <exception>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <fstream>
+#include <unordered_map>
 
 namespace str {
     // 常用字符串常量
@@ -24,6 +36,68 @@ namespace str {
     void lower(std::basic_string<char>& str);
     void lower(std::basic_string<wchar_t>& str);
     std::string random(std::size_t n);
+
+    // 不持有内存的字符串视图
+    struct View {
+        View();
+        View(const char* data, std::size_t size);
+        std::string str() const;
+        bool startswith(const char* prefix) const;
+        bool operator==(const char* other) const;
+        bool operator!=(const char* other) const;
+
+        const char* data;
+        std::size_t size;
+    };
+    // 十进制无符号整数，空串、非数字或超出 uint64_t 时返回 false
+    bool to_uint(const View& view, std::uint64_t& value);
+
+    // 按编译期列数切分一行，只记录前 Used 列，不分配内存
+    template <std::size_t Columns, std::size_t Used = Columns>
+    class Fields {
+        static_assert((Used > 0) && (Used <= Columns), "invalid column schema");
+    public:
+        explicit Fields(const char* sep) : sep_(sep), length_(std::strlen(sep)) {}
+
+        // 返回该行是否恰好有 Columns 列
+        bool split(const char* begin, const char* end) {
+            std::size_t i = 0;
+            const char* p = begin;
+            while (true) {
+                const char* q = find(p, end);
+                if (i < Used) {
+                    columns_[i] = View(p, (q ? q : end) - p);
+                }
+                ++i;
+                if (q == nullptr) break;
+                if (i == Columns) return false;
+                p = q + length_;
+            }
+            return i == Columns;
+        }
+        bool split(const std::string& line) {
+            return split(line.data(), line.data() + line.size());
+        }
+        bool split(std::string&& line) = delete;  // 视图不能指向临时字符串
+        const View& operator[](std::size_t i) const {
+            return columns_[i];
+        }
+    private:
+        const char* find(const char* p, const char* end) const {
+            if (length_ == 0) return nullptr;
+            while (p + length_ <= end) {
+                const char* q = static_cast<const char*>(std::memchr(p, sep_[0], end - p));
+                if ((q == nullptr) || (q + length_ > end)) return nullptr;
+                if (std::memcmp(q, sep_, length_) == 0) return q;
+                p = q + 1;
+            }
+            return nullptr;
+        }
+    private:
+        const char* sep_;
+        std::size_t length_;
+        View columns_[Used];
+    };
 } // namespace str
 
 namespace os {
@@ -37,7 +111,217 @@ namespace os {
 #endif
         bool exists(const std::string& path);
         std::string join(std::initializer_list<std::string> paths);
+        std::uint64_t size(const std::string& path);
+        std::int64_t mtime(const std::string& path);  // 纳秒
+        std::uint64_t fingerprint(const std::string& path);  // 抽样内容哈希
+        std::uint64_t fingerprint(const std::string& path, std::uint64_t size);  // 只取前 size 字节，用于判断是否为追加
+        bool is_gzip(const std::string& path);  // 按魔数判断
+        bool is_bgzf(const std::string& path);  // gzip 且首块带 BC 扩展字段
+        std::string absolute(const std::string& path);  // 相对路径按当前工作目录补全，并按词法去掉 . 与 .. 分量
     }
+
+    // 当前进程的资源使用，读自 linux 的 /proc，不可用时为 0
+    std::uint64_t peak_rss();  // 峰值常驻内存，字节
+    void reset_peak_rss();  // 把峰值重置为当前常驻内存
+    std::uint64_t io_read_bytes();  // 实际从存储设备读取的字节数，不含页缓存命中
+    std::uint64_t io_write_bytes();
+
+    // 只读内存映射文件
+    class MappedFile {
+    public:
+        MappedFile();
+        explicit MappedFile(const std::string& path);
+        MappedFile(MappedFile&& other);
+        MappedFile& operator=(MappedFile&& other);
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        ~MappedFile();
+
+        const char* data() const;
+        std::size_t size() const;
+        void advise_sequential() const;
+    private:
+        void close();
+    private:
+        char* data_;
+        std::size_t size_;
+    };
+
+    // 文件描述符的 RAII 封装，读写不完整时抛出异常
+    class File {
+    public:
+        enum Mode {
+            READ,  // 只读
+            WRITE  // 创建或清空后写入
+        };
+    public:
+        File();
+        File(const std::string& path, Mode mode);
+        File(File&& other);
+        File& operator=(File&& other);
+        File(const File&) = delete;
+        File& operator=(const File&) = delete;
+        ~File();
+
+        int fd() const;
+        const std::string& path() const;
+        void pread(char* buffer, std::size_t n, std::uint64_t offset) const;
+        void write(const char* data, std::size_t n);
+        // 从 in 的 offset 处零拷贝追加 length 字节（copy_file_range，其次 sendfile），
+        // 内核不支持时返回 false 且未写入任何内容
+        bool copy_from(const File& in, std::uint64_t offset, std::uint64_t length);
+        // 同上但写到本文件的 out_offset 处，不改变文件位置，只尝试 copy_file_range
+        bool copy_from(const File& in, std::uint64_t offset, std::uint64_t length, std::uint64_t out_offset);
+        void pwrite(const char* data, std::size_t n, std::uint64_t offset) const;
+        // 预分配到 size 字节，文件系统不支持时退化为 ftruncate，不是普通文件时返回 false
+        bool allocate(std::uint64_t size);
+        void close();
+    private:
+        std::string path_;
+        int fd_;
+    };
+
+    // 整体替换 path：先写入同目录下的临时文件，commit() 时落盘（fsync）后改名为 path，
+    // 并发的读者只会看到旧文件或完整的新文件，崩溃后也不会留下写了一半的 path；
+    // 未 commit 即析构时删除临时文件
+    class AtomicFile {
+    public:
+        explicit AtomicFile(const std::string& path);
+        AtomicFile(const AtomicFile&) = delete;
+        AtomicFile& operator=(const AtomicFile&) = delete;
+        ~AtomicFile();
+
+        const std::string& path() const;
+        std::ofstream& stream();
+        void commit();  // 写入失败时抛出异常，临时文件被删除
+    private:
+        std::string path_;
+        std::string tmp_path_;
+        std::ofstream out_;
+    };
+
+    // gzip 流式读取，解压在独立线程中进行，通过有界队列交给调用方
+    class GzipReader {
+    public:
+        explicit GzipReader(const std::string& path, std::size_t block_size = 4 << 20, std::size_t capacity = 4);
+        GzipReader(const GzipReader&) = delete;
+        GzipReader& operator=(const GzipReader&) = delete;
+        ~GzipReader();
+
+        // 按顺序取出下一块解压数据，读完返回 false，解压错误在此重新抛出
+        bool next(std::string& block);
+        // 已取出的数据对应的压缩文件字节数，用于显示进度
+        std::uint64_t tell() const;
+    private:
+        void run();
+    private:
+        std::string path_;
+        std::size_t block_size_;
+        std::size_t capacity_;
+        std::deque<std::string> queue_;
+        std::deque<std::uint64_t> offsets_;  // 每块读完时压缩文件的位置
+        std::uint64_t offset_;
+        bool done_;
+        bool stopped_;
+        std::exception_ptr error_;
+        std::mutex mutex_;
+        std::condition_variable not_empty_;
+        std::condition_variable not_full_;
+        std::thread worker_;
+    };
+
+    // BGZF（bgzip）块压缩文件的随机读取，按解压后的偏移定位块，并缓存最近解压的块
+    class BgzfFile {
+    public:
+        // 块的压缩偏移与解压后偏移，二者合起来即虚拟偏移
+        struct Block {
+            std::uint64_t coffset;
+            std::uint64_t uoffset;
+        };
+    public:
+        explicit BgzfFile(const std::string& path, std::size_t cache_size = 64);
+        BgzfFile(const BgzfFile&) = delete;
+        BgzfFile& operator=(const BgzfFile&) = delete;
+        ~BgzfFile();
+
+        // 把解压后 [pos, pos+length) 的内容追加到 out
+        void read(std::uint64_t pos, std::size_t length, std::string& out);
+
+        // 扫描块头得到块表，不解压
+        static void scan(const std::string& path, std::vector<Block>& blocks);
+        // 读写与 bgzip -i 兼容的 .gzi 块索引；save 在末尾附加 path 的大小和修改时间（bgzip 忽略），
+        // load 据此核对 path，没有附加信息时（bgzip 生成）要求 .gzi 不早于 path；
+        // 文件不存在、无效或与 path 不符时 load 返回 false
+        static bool load(const std::string& file, const std::string& path, std::vector<Block>& blocks);
+        static void save(const std::string& file, const std::string& path, const std::vector<Block>& blocks);
+    private:
+        const std::string& inflate(std::size_t block);
+    private:
+        std::string path_;
+        int fd_;
+        std::vector<Block> blocks_;
+        std::size_t cache_size_;
+        std::list<std::pair<std::size_t, std::string>> cache_;  // 最近使用的在前
+        std::unordered_map<std::size_t, std::list<std::pair<std::size_t, std::string>>::iterator> cached_;
+        std::string compressed_;
+    };
+
+    // 长时间扫描的进度，定期在 stderr 的同一行刷新已处理字节数、吞吐量和预计剩余时间；
+    // 只有 enable(true) 之后才会输出（main 在 stderr 是终端时开启），否则不启动线程也不输出
+    class Progress {
+    public:
+        Progress(const std::string& label, std::uint64_t total, double interval = 1.0);
+        Progress(const Progress&) = delete;
+        Progress& operator=(const Progress&) = delete;
+        ~Progress();
+
+        void add(std::uint64_t bytes);  // 线程安全
+        void set(std::uint64_t done);
+        static void enable(bool enabled);
+        static bool enabled();
+    private:
+        void run();
+        void report(bool last);
+    private:
+        std::string label_;
+        std::uint64_t total_;
+        double interval_;
+        std::atomic<std::uint64_t> done_;
+        std::chrono::steady_clock::time_point start_;
+        bool reported_;
+        bool stopped_;
+        std::mutex mutex_;
+        std::condition_variable wakeup_;
+        std::thread worker_;
+    };
+
+    // unix 域流式套接字的 RAII 封装，按行收发
+    class Socket {
+    public:
+        Socket();
+        Socket(Socket&& other);
+        Socket& operator=(Socket&& other);
+        Socket(const Socket&) = delete;
+        Socket& operator=(const Socket&) = delete;
+        ~Socket();
+
+        // 在 path 上监听，套接字文件权限为 0600；残留的套接字文件会被替换，其它已存在的文件则抛出异常
+        static Socket listen(const std::string& path, int backlog = 128);
+        static Socket connect(const std::string& path);
+        // 等待下一个连接，监听套接字被 shutdown 后返回无效的套接字
+        Socket accept() const;
+        bool valid() const;
+        // 读取一行（不含换行符），对端关闭且没有剩余数据时返回 false
+        bool read_line(std::string& line);
+        void write(const std::string& data) const;
+        // 可在信号处理函数中调用，用于唤醒阻塞在 accept 上的线程
+        void shutdown() const;
+    private:
+        explicit Socket(int fd);
+    private:
+        int fd_;
+        std::string buffer_;
+    };
 }
 
 #endif //UTILS_UTILS_H